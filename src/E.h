@@ -153,6 +153,7 @@ typedef struct {
       char                user;
       char                no_scan;
       int                 timeout;
+      char                async;
    } backgrounds;
    struct {
       int                 move_resistance;
@@ -275,6 +276,10 @@ typedef struct {
       char                firsttime;
       char                animate;
    } startup;
+   struct {
+      int                 idle_delay;	/* ms without input until idle */
+      int                 idle_slack_factor;
+   } timers;
    struct {
       char                use_theme_font_cfg;
       char                use_alt_font_cfg;
@@ -316,11 +321,15 @@ typedef struct {
       char                argb_clients;
       char                argb_clients_inherit_attr;
       int                 image_cache_size;
+      int                 pixmap_cache_size;	/* kB */
       int                 mask_alpha_threshold;
       char                enable_startup_id;
       char                use_render_for_scaling;
       char                bindings_reload;
       unsigned int        no_sync_mask;
+#if USE_EPOLL
+      char                use_epoll;
+#endif
    } testing;
 
    char                autosave;
@@ -354,6 +363,7 @@ typedef struct {
    struct {
       unsigned int        seqn;	/* Event run sequence number */
       unsigned int        time_ms;	/* Local ms time */
+      unsigned int        input_time_ms;	/* Local ms time of last input */
       EX_Time             time;	/* Latest X event time */
       int                 cx, cy;	/* Any detected pointer movement */
       int                 mx, my;	/* Motion event */
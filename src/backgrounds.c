@@ -23,7 +23,15 @@
  */
 #include "config.h"
 
+#include <fcntl.h>
+#if ENABLE_BENCHMARKS
+#include <poll.h>
+#endif
+#include <signal.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <X11/Xlib.h>
 
 #include "E.h"
@@ -32,6 +40,7 @@
 #include "dialog.h"
 #include "eimage.h"
 #include "emodule.h"
+#include "events.h"
 #include "file.h"
 #include "iclass.h"
 #include "list.h"
@@ -48,6 +57,8 @@ typedef struct {
    int                 xperc, yperc;
 } BgPart;
 
+typedef struct _bgjob BgJob;
+
 struct _background {
    dlist_t             list;
    char               *name;
@@ -62,6 +73,9 @@ struct _background {
    char                referenced;
    unsigned int        ref_count;
    unsigned int        seq_no;
+   BgJob              *job;
+   EX_Pixmap           pmap_old;	/* Shown while job is pending */
+   char                no_async;
 };
 
 static              LIST_HEAD(bg_list);
@@ -72,6 +86,9 @@ static unsigned int bg_seq_no = 0;
 #define N_BG_ASSIGNED 32
 static Background  *bg_assigned[N_BG_ASSIGNED];
 
+static void         _BgJobCancel(Background * bg);
+static void         _BackgroundPixmapOldFree(Background * bg);
+
 static char        *
 _BackgroundGetFile(char **ptr)
 {
@@ -202,6 +219,16 @@ BackgroundPixmapFree(Background * bg)
      }
 }
 
+static void
+_BackgroundPixmapOldFree(Background * bg)
+{
+   if (bg->pmap_old)
+     {
+	EImagePixmapsFree(bg->pmap_old, NoXID);
+	bg->pmap_old = NoXID;
+     }
+}
+
 static void
 BackgroundImagesFree(Background * bg)
 {
@@ -263,8 +290,10 @@ BackgroundDestroy(Background * bg)
 
    LIST_REMOVE(Background, &bg_list, bg);
 
+   _BgJobCancel(bg);
    BackgroundFilesRemove(bg);
    BackgroundPixmapFree(bg);
+   _BackgroundPixmapOldFree(bg);
 
    Efree(bg->name);
 
@@ -410,10 +439,24 @@ BackgroundDestroyByName(const char *name)
 static void
 BackgroundInvalidate(Background * bg, int refresh)
 {
-   BackgroundPixmapFree(bg);
+   _BgJobCancel(bg);
+   if (bg->ref_count && refresh && bg->pmap != NoXID)
+     {
+	/* Desks may show the old pixmap until the new one is ready */
+	_BackgroundPixmapOldFree(bg);
+	bg->pmap_old = bg->pmap;
+	bg->pmap = NoXID;
+     }
+   else
+     {
+	BackgroundPixmapFree(bg);
+     }
+   bg->no_async = 0;
    bg->seq_no = ++bg_seq_no;
    if (bg->ref_count && refresh)
       DesksBackgroundRefresh(bg, DESK_BG_REFRESH);
+   if (!bg->job)
+      _BackgroundPixmapOldFree(bg);
 }
 
 static int
@@ -553,16 +596,10 @@ BackgroundCreatePixmap(Win win, unsigned int w, unsigned int h)
    return pmap;
 }
 
-void
-BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
-		  unsigned int rw, unsigned int rh, int is_win,
-		  EX_Pixmap * ppmap, unsigned int *ppixel)
+static void
+_BackgroundImagesLoad(Background * bg)
 {
-   EX_Pixmap           pmap;
-   int                 x, y, ww, hh;
-   unsigned int        w, h;
-   char               *file, hasbg, hasfg;
-   EImage             *im;
+   char               *file;
 
    if (!bg->bg.im)
      {
@@ -577,31 +614,47 @@ BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
 	if (file)
 	   bg->top.im = EImageLoad(bg->top.file);
      }
+}
 
-   if (!draw)
-      draw = WinGetXwin(win);
+/*
+ * Check if the (loaded) background can be applied to a window as a single
+ * w x h image: No fg, no offset, and scale to 100%, or tiled, no trans.
+ */
+static int
+_BackgroundIsSimple(Background * bg, unsigned int rw, unsigned int rh,
+		    unsigned int *pw, unsigned int *ph)
+{
+   int                 x, y;
+   unsigned int        w, h;
 
-   hasbg = ! !bg->bg.im;
-   hasfg = ! !bg->top.im;
+   if (!bg->bg.im || bg->top.im)
+      return 0;
 
-   if (!hasbg && !hasfg)
-     {
-	unsigned int        pixel;
+   BgFindImageSize(&(bg->bg), rw, rh, &w, &h);
+   x = ((int)(rw - w) * bg->bg.xjust) >> 10;
+   y = ((int)(rh - h) * bg->bg.yjust) >> 10;
 
-	/* Solid color only */
-	pixel = EAllocColor(WinGetCmap(VROOT), bg->bg_solid);
+   *pw = w;
+   *ph = h;
 
-	if (!is_win)
-	   EXFillAreaSolid(draw, 0, 0, rw, rh, pixel);
+   return x == 0 && y == 0 &&
+      ((w == rw && h == rh) || (bg->bg_tile && !TransparencyEnabled()));
+}
 
-	if (ppmap)
-	   *ppmap = NoXID;
-	if (ppixel)
-	   *ppixel = pixel;
-	return;
-     }
+/*
+ * Compose the full size (rw x rh) background image from the loaded bg/fg
+ * images. May return bg->bg.im, otherwise the caller must free it.
+ */
+static EImage      *
+_BackgroundImageCompose(Background * bg, unsigned int rw, unsigned int rh)
+{
+   int                 x, y, ww, hh;
+   unsigned int        w, h;
+   char                hasbg, hasfg;
+   EImage             *im;
 
-   /* Has either bg or fg image */
+   hasbg = ! !bg->bg.im;
+   hasfg = ! !bg->top.im;
 
    w = h = x = y = 0;
 
@@ -612,22 +665,6 @@ BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
 	y = ((int)(rh - h) * bg->bg.yjust) >> 10;
      }
 
-   if (is_win && hasbg && !hasfg && x == 0 && y == 0 &&
-       ((w == rw && h == rh) || (bg->bg_tile && !TransparencyEnabled())))
-     {
-	/* Window, no fg, no offset, and scale to 100%, or tiled, no trans */
-	pmap = BackgroundCreatePixmap(win, w, h);
-	EImageRenderOnDrawable(bg->bg.im, win, pmap, EIMAGE_ANTI_ALIAS,
-			       0, 0, w, h);
-	goto done;
-     }
-
-   /* The rest that require some more work */
-   if (is_win)
-      pmap = BackgroundCreatePixmap(win, rw, rh);
-   else
-      pmap = draw;
-
    if (hasbg && !hasfg && x == 0 && y == 0 && w == rw && h == rh)
      {
 	im = bg->bg.im;
@@ -669,6 +706,58 @@ BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
 		    0, 0, ww, hh, x, y, w, h, 0);
      }
 
+   return im;
+}
+
+void
+BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
+		  unsigned int rw, unsigned int rh, int is_win,
+		  EX_Pixmap * ppmap, unsigned int *ppixel)
+{
+   EX_Pixmap           pmap;
+   unsigned int        w, h;
+   EImage             *im;
+
+   _BackgroundImagesLoad(bg);
+
+   if (!draw)
+      draw = WinGetXwin(win);
+
+   if (!bg->bg.im && !bg->top.im)
+     {
+	unsigned int        pixel;
+
+	/* Solid color only */
+	pixel = EAllocColor(WinGetCmap(VROOT), bg->bg_solid);
+
+	if (!is_win)
+	   EXFillAreaSolid(draw, 0, 0, rw, rh, pixel);
+
+	if (ppmap)
+	   *ppmap = NoXID;
+	if (ppixel)
+	   *ppixel = pixel;
+	return;
+     }
+
+   /* Has either bg or fg image */
+
+   if (is_win && _BackgroundIsSimple(bg, rw, rh, &w, &h))
+     {
+	pmap = BackgroundCreatePixmap(win, w, h);
+	EImageRenderOnDrawable(bg->bg.im, win, pmap, EIMAGE_ANTI_ALIAS,
+			       0, 0, w, h);
+	goto done;
+     }
+
+   /* The rest that require some more work */
+   if (is_win)
+      pmap = BackgroundCreatePixmap(win, rw, rh);
+   else
+      pmap = draw;
+
+   im = _BackgroundImageCompose(bg, rw, rh);
+
    EImageRenderOnDrawable(im, win, pmap, EIMAGE_ANTI_ALIAS, 0, 0, rw, rh);
    if (im != bg->bg.im)
       EImageFree(im);
@@ -683,6 +772,354 @@ BackgroundRealize(Background * bg, Win win, EX_Drawable draw,
       *ppixel = 0;
 }
 
+/*
+ * Asynchronous background realization.
+ *
+ * Decoding and scaling large background images may take hundreds of ms.
+ * Imlib2 is not thread safe, so the work is done in a forked helper which
+ * leaves the composed pixels in a shared mapping and writes the job id to
+ * the job pipe when done. The main loop picks it up, renders the pixmap,
+ * and refreshes the desks using the background.
+ */
+typedef struct {
+   int                 ok;
+   unsigned int        w, h;
+} BgJobHdr;
+
+struct _bgjob {
+   unsigned int        id;
+   pid_t               pid;
+   unsigned int        seq_no;
+   unsigned int        rw, rh;
+   BgJobHdr           *hdr;	/* Shared mapping, pixels follow header */
+   size_t              size;
+   unsigned int        t_start;
+#if ENABLE_BENCHMARKS
+   char                bench;	/* Started by _BackgroundBench() */
+#endif
+};
+
+#if ENABLE_BENCHMARKS
+#define BgJobIsBench(job) ((job)->bench)
+#else
+#define BgJobIsBench(job) 0
+#endif
+
+static int          bg_job_fd[2] = { -1, -1 };
+static unsigned int bg_job_id = 0;
+
+static void         _BgJobsHandle(void);
+
+static int
+_BgJobsInit(void)
+{
+   if (bg_job_fd[0] >= 0)
+      return 0;
+
+   if (pipe(bg_job_fd))
+     {
+	bg_job_fd[0] = bg_job_fd[1] = -1;
+	return -1;
+     }
+   fcntl(bg_job_fd[0], F_SETFD, FD_CLOEXEC);
+   fcntl(bg_job_fd[1], F_SETFD, FD_CLOEXEC);
+   fcntl(bg_job_fd[0], F_SETFL, O_NONBLOCK);
+
+   EventFdRegister(bg_job_fd[0], _BgJobsHandle);
+
+   return 0;
+}
+
+static void
+_BgJobFree(BgJob * job)
+{
+   if (job->hdr)
+      munmap(job->hdr, job->size);
+   Efree(job);
+}
+
+static void
+_BgJobCancel(Background * bg)
+{
+   BgJob              *job = bg->job;
+   sigset_t            mask, omask;
+
+   if (!job)
+      return;
+
+   bg->job = NULL;
+
+   /* The SIGCHLD handler reaps any exited child, after which the pid may
+    * be reused. Keep it from running while we check that the helper is
+    * still ours, and only kill it if it is. */
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &mask, &omask);
+   if (waitpid(job->pid, NULL, WNOHANG) == 0)
+     {
+	kill(job->pid, SIGKILL);
+	waitpid(job->pid, NULL, 0);
+     }
+   sigprocmask(SIG_SETMASK, &omask, NULL);
+
+   _BgJobFree(job);
+}
+
+static void
+_BgJobChild(Background * bg, BgJob * job)
+{
+   BgJobHdr           *hdr = job->hdr;
+   EImage             *im;
+   unsigned int        w, h;
+   int                 iw, ih;
+
+   SignalsRestore();
+
+   _BackgroundImagesLoad(bg);
+
+   im = NULL;
+   if (_BackgroundIsSimple(bg, job->rw, job->rh, &w, &h) &&
+       w * h <= job->rw * job->rh)
+     {
+	EImageGetSize(bg->bg.im, &iw, &ih);
+	if ((int)w == iw && (int)h == ih)
+	  {
+	     im = bg->bg.im;
+	  }
+	else
+	  {
+	     im = EImageCreate(w, h);
+	     EImageSetHasAlpha(im, 0);
+	     EImageBlend(im, bg->bg.im, EIMAGE_ANTI_ALIAS, 0, 0, iw, ih,
+			 0, 0, w, h, 0);
+	  }
+     }
+   else if (bg->bg.im || bg->top.im)
+     {
+	w = job->rw;
+	h = job->rh;
+	im = _BackgroundImageCompose(bg, w, h);
+     }
+
+   if (im)
+     {
+	memcpy(hdr + 1, EImageGetData(im), w * h * sizeof(unsigned int));
+	hdr->w = w;
+	hdr->h = h;
+	hdr->ok = 1;
+     }
+
+   if (write(bg_job_fd[1], &job->id, sizeof(job->id)) != sizeof(job->id))
+      _exit(1);
+   _exit(0);
+}
+
+static BgJob       *
+_BgJobStart(Background * bg, unsigned int rw, unsigned int rh)
+{
+   BgJob              *job;
+   void               *p;
+   pid_t               pid;
+
+   if (_BgJobsInit())
+      return NULL;
+
+   job = ECALLOC(BgJob, 1);
+   if (!job)
+      return NULL;
+
+   job->id = ++bg_job_id;
+   job->seq_no = bg->seq_no;
+   job->rw = rw;
+   job->rh = rh;
+   job->size = sizeof(BgJobHdr) + rw * rh * sizeof(unsigned int);
+   p = mmap(NULL, job->size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (p == MAP_FAILED)
+     {
+	Efree(job);
+	return NULL;
+     }
+   job->hdr = (BgJobHdr *) p;
+   job->t_start = GetTimeUs();
+
+   pid = fork();
+   if (pid < 0)
+     {
+	_BgJobFree(job);
+	return NULL;
+     }
+   if (pid == 0)
+      _BgJobChild(bg, job);	/* Does not return */
+
+   job->pid = pid;
+   bg->job = job;
+
+   return job;
+}
+
+static void
+_BgJobFinish(Background * bg)
+{
+   BgJob              *job = bg->job;
+   BgJobHdr           *hdr = job->hdr;
+   EX_Pixmap           pmap;
+   EImage             *im;
+
+   bg->job = NULL;
+
+   pmap = NoXID;
+   if (hdr->ok)
+     {
+	im = EImageCreateFromData(hdr->w, hdr->h, (unsigned int *)(hdr + 1));
+	pmap = BackgroundCreatePixmap(VROOT, hdr->w, hdr->h);
+	EImageRenderOnDrawable(im, VROOT, pmap, 0, 0, 0, hdr->w, hdr->h);
+	EImageFree(im);
+     }
+
+   if (EDebug(EDBUG_TYPE_DESKS))
+      Eprintf("%s: %s %ux%u ok=%d: ready after %.2f ms\n", __func__,
+	      bg->name, job->rw, job->rh, hdr->ok,
+	      (GetTimeUs() - job->t_start) * 1e-3);
+
+   if (BgJobIsBench(job))
+     {
+	if (pmap != NoXID)
+	   EImagePixmapsFree(pmap, NoXID);
+	_BgJobFree(job);
+	return;
+     }
+
+   _BgJobFree(job);
+
+   /* If failed, let the next refresh do it the old way */
+   if (pmap == NoXID)
+      bg->no_async = 1;
+   else if (bg->pmap == NoXID)
+      bg->pmap = pmap;
+   else				/* Realized synchronously in the mean time */
+      EImagePixmapsFree(pmap, NoXID);
+
+   DesksBackgroundRefresh(bg, DESK_BG_REFRESH);
+   _BackgroundPixmapOldFree(bg);
+}
+
+static void
+_BgJobsHandle(void)
+{
+   Background         *bg;
+   unsigned int        id;
+
+   while (read(bg_job_fd[0], &id, sizeof(id)) == sizeof(id))
+     {
+	LIST_FOR_EACH(Background, &bg_list, bg)
+	{
+	   if (!bg->job || bg->job->id != id)
+	      continue;
+	   _BgJobFinish(bg);
+	   break;
+	}
+     }
+}
+
+/*
+ * Start realizing the background pixmap (rw x rh) in the background.
+ * Returns 1 if the pixmap is pending, 0 if the caller must realize
+ * synchronously.
+ * While pending the caller should show *ppmap or *ppixel: The previous pixmap
+ * of a modified background, otherwise its solid color. The desks using the
+ * background are refreshed when the pixmap is ready.
+ */
+int
+BackgroundRealizeAsync(Background * bg, unsigned int rw, unsigned int rh,
+		       EX_Pixmap * ppmap, unsigned int *ppixel)
+{
+   if (!Conf.backgrounds.async || Mode.wm.startup || bg->no_async)
+      return 0;
+   if (!_BackgroundGetBgFile(bg) && !_BackgroundGetFgFile(bg))
+      return 0;			/* Solid color only */
+
+   if (bg->job && (BgJobIsBench(bg->job) || bg->job->seq_no != bg->seq_no ||
+		   bg->job->rw != rw || bg->job->rh != rh))
+      _BgJobCancel(bg);
+
+   if (!bg->job && !_BgJobStart(bg, rw, rh))
+      return 0;
+
+   if (bg->pmap_old != NoXID)
+     {
+	*ppmap = bg->pmap_old;
+	*ppixel = 0;
+     }
+   else
+     {
+	*ppmap = NoXID;
+	*ppixel = EAllocColor(WinGetCmap(VROOT), bg->bg_solid);
+     }
+
+   return 1;
+}
+
+#if ENABLE_BENCHMARKS
+static void
+_BackgroundBench(Background * bg, int n)
+{
+   unsigned int        rw, rh, t0, t1, t2, t_sync, t_block, t_ready;
+   EX_Pixmap           pmap;
+   struct pollfd       pfd;
+   int                 i;
+
+   if (bg->job)
+     {
+	IpcPrintf("Background %s is busy\n", bg->name);
+	return;
+     }
+
+   rw = WinGetW(VROOT);
+   rh = WinGetH(VROOT);
+
+   /* Synchronous, what DeskGoto used to block on */
+   t0 = GetTimeUs();
+   for (i = 0; i < n; i++)
+     {
+	BackgroundRealize(bg, VROOT, NoXID, rw, rh, 1, &pmap, NULL);
+	if (pmap != NoXID)
+	   EImagePixmapsFree(pmap, NoXID);
+     }
+   t_sync = GetTimeUs() - t0;
+
+   /* Asynchronous, main loop is blocked only while forking and rendering */
+   t_block = t_ready = 0;
+   for (i = 0; i < n; i++)
+     {
+	t0 = GetTimeUs();
+	if (!_BgJobStart(bg, rw, rh))
+	  {
+	     IpcPrintf("Failed to start job\n");
+	     return;
+	  }
+	bg->job->bench = 1;
+	t1 = GetTimeUs();
+	pfd.fd = bg_job_fd[0];
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 10000) <= 0)
+	  {
+	     IpcPrintf("Job timed out\n");
+	     _BgJobCancel(bg);
+	     return;
+	  }
+	t2 = GetTimeUs();
+	_BgJobsHandle();
+	t_block += (t1 - t0) + (GetTimeUs() - t2);
+	t_ready += GetTimeUs() - t0;
+     }
+
+   IpcPrintf("%s %ux%u: sync %.2f ms - async blocked %.2f ms, ready %.2f ms\n",
+	     bg->name, rw, rh, t_sync * 1e-3 / n, t_block * 1e-3 / n,
+	     t_ready * 1e-3 / n);
+}
+#endif /* ENABLE_BENCHMARKS */
+
 void
 BackgroundApplyPmap(Background * bg, Win win, EX_Drawable draw,
 		    unsigned int w, unsigned int h)
@@ -1331,6 +1768,16 @@ BackgroundsAccounting(void)
    now = time(NULL);
    LIST_FOR_EACH(Background, &bg_list, bg)
    {
+      /* Give up on helpers that died without reporting back */
+      if (bg->job && !BgJobIsBench(bg->job) &&
+	  GetTimeUs() - bg->job->t_start > 10000000)
+	{
+	   _BgJobCancel(bg);
+	   bg->no_async = 1;
+	   DesksBackgroundRefresh(bg, DESK_BG_REFRESH);
+	   _BackgroundPixmapOldFree(bg);
+	}
+
       /* Skip if no pixmap or not timed out */
       if (bg->pmap == NoXID ||
 	  ((now - bg->last_viewed) <= Conf.backgrounds.timeout))
@@ -1372,6 +1819,7 @@ BackgroundsSighan(int sig, void *prm __UNUSED__)
 
      case ESIGNAL_START:
 	TIMER_ADD(bg_timer, 30000, BackgroundsTimeout, NULL);
+	TimerSetSlack(bg_timer, 5000);
 	break;
 
      case ESIGNAL_EXIT:
@@ -2421,6 +2869,20 @@ BackgroundsIpc(const char *params)
 	BackgroundApplyWin(bg, win);
 	EDestroyWin(win);
      }
+#if ENABLE_BENCHMARKS
+   else if (!strcmp(cmd, "bench"))
+     {
+	bg = BackgroundFind(prm);
+	if (!bg)
+	   return;
+
+	num = 5;
+	sscanf(p, "%d", &num);
+	if (num <= 0)
+	   num = 1;
+	_BackgroundBench(bg, num);
+     }
+#endif
    else if (!strncmp(cmd, "del", 2))
      {
 	BackgroundDestroyByName(prm);
@@ -2530,6 +2992,9 @@ static const IpcItem BackgroundsIpcArray[] = {
     "Background commands",
     "  background                       Show current background\n"
     "  background apply <name> <win>    Apply background to window\n"
+#if ENABLE_BENCHMARKS
+    "  background bench <name> [num]    Time sync vs async realization\n"
+#endif
     "  background del <name>            Delete background\n"
     "  background list                  Show all background\n"
     "  background load <name> <file>    Load new wallpaper from file\n"
@@ -2553,6 +3018,7 @@ static const CfgItem BackgroundsCfgItems[] = {
    CFG_ITEM_BOOL(Conf.backgrounds, user, 1),
    CFG_ITEM_BOOL(Conf.backgrounds, no_scan, 0),
    CFG_ITEM_INT(Conf.backgrounds, timeout, 240),
+   CFG_ITEM_BOOL(Conf.backgrounds, async, 1),
 };
 #define N_CFG_ITEMS (sizeof(BackgroundsCfgItems)/sizeof(CfgItem))
 
@@ -34,6 +34,9 @@ void                BackgroundRealize(Background * bg, Win win,
 				      EX_Drawable draw, unsigned int rw,
 				      unsigned int rh, int is_win,
 				      EX_Pixmap * ppmap, unsigned int *ppixel);
+int                 BackgroundRealizeAsync(Background * bg, unsigned int rw,
+					   unsigned int rh, EX_Pixmap * ppmap,
+					   unsigned int *ppixel);
 void                BackgroundApplyPmap(Background * bg, Win win,
 					EX_Drawable draw, unsigned int rw,
 					unsigned int rh);
@@ -621,6 +621,11 @@ DeskBackgroundRefresh(Desk * dsk, int why)
 	     pmap = BackgroundGetPixmap(bg);
 	     pixel = 0;
 
+	     if (pmap == NoXID &&
+		 BackgroundRealizeAsync(bg, EoGetW(dsk), EoGetH(dsk),
+					&pmap, &pixel))
+		goto done;	/* Refreshed again when the pixmap is ready */
+
 	     if (pmap == NoXID)
 		BackgroundRealize(bg, EoGetWin(dsk), NoXID,
 				  EoGetW(dsk), EoGetH(dsk), 1, &pmap, &pixel);
@@ -1421,6 +1426,7 @@ DeskRestackSimple(Desk * dsk)
       return;			/* eo not in list (can this happen?) */
 
    eo->stacked = 1;
+   eo->stack_gen = 0;		/* Not tracked by DeskRestackMinimal() */
 
    if (EDebug(EDBUG_TYPE_STACKING))
       Eprintf("%s: %#x %s\n", __func__, EobjGetXwin(eo), EobjGetName(eo));
@@ -1445,17 +1451,102 @@ DeskRestackSimple(Desk * dsk)
    XConfigureWindow(disp, EobjGetXwin(eo), value_mask, &xwc);
 }
 
-#define _APPEND_TO_WIN_LIST(win) \
-  { \
-     wl = EREALLOC(EX_Window, wl, ++tot); \
-     wl[tot - 1] = win; \
-  }
+/*
+ * Restack by moving as few windows as possible.
+ * The objects whose positions at the last restack are known and form the
+ * longest sequence still in order stay put, the rest are moved next to a
+ * neighbour.
+ * Returns the number of moves, -1 if a full restack would be cheaper.
+ */
+static int
+DeskRestackMinimal(Desk * dsk, EObj * const *lst, int num)
+{
+   int                *pos, *tail, *prev;
+   char               *keep;
+   int                 i, j, lo, hi, mid, len, nmove;
+   XWindowChanges      xwc;
+
+   pos = EMALLOC(int, 3 * num);
+   keep = ECALLOC(char, num);
+   if (!pos || !keep)
+     {
+	nmove = -1;
+	goto done;
+     }
+   tail = pos + num;
+   prev = tail + num;
+
+   /* Find the longest increasing sequence of old positions */
+   len = 0;
+   for (i = 0; i < num; i++)
+     {
+	if (lst[i]->stack_gen == 0 || lst[i]->stack_gen != dsk->stack.gen ||
+	    lst[i]->type == EOBJ_TYPE_EXT)
+	   continue;		/* Position unknown, must be moved */
+	pos[i] = lst[i]->stack_pos;
+
+	for (lo = 0, hi = len; lo < hi;)
+	  {
+	     mid = (lo + hi) / 2;
+	     if (pos[tail[mid]] < pos[i])
+		lo = mid + 1;
+	     else
+		hi = mid;
+	  }
+	prev[i] = (lo > 0) ? tail[lo - 1] : -1;
+	tail[lo] = i;
+	if (lo == len)
+	   len++;
+     }
+   for (i = (len > 0) ? tail[len - 1] : -1; i >= 0; i = prev[i])
+      keep[i] = 1;
+
+   nmove = num - len;
+   if (len == 0 || nmove >= num - 1)
+     {
+	nmove = -1;
+	goto done;
+     }
+
+   xwc.stack_mode = Above;
+   for (j = 0; !keep[j]; j++)
+      ;
+   for (i = j - 1; i >= 0; i--)
+     {
+	/* Above the first kept one */
+	xwc.sibling = EobjGetXwin(lst[i + 1]);
+	XConfigureWindow(disp, EobjGetXwin(lst[i]), CWSibling | CWStackMode,
+			 &xwc);
+     }
+   xwc.stack_mode = Below;
+   for (i = j + 1; i < num; i++)
+     {
+	if (keep[i])
+	   continue;
+	xwc.sibling = EobjGetXwin(lst[i - 1]);
+	XConfigureWindow(disp, EobjGetXwin(lst[i]), CWSibling | CWStackMode,
+			 &xwc);
+     }
+
+   if (EDebug(EDBUG_TYPE_STACKING))
+     {
+	for (i = 0; i < num; i++)
+	   Eprintf(" win=%#10x %s\n", EobjGetXwin(lst[i]),
+		   keep[i] ? "keep" : "move");
+     }
+
+ done:
+   Efree(pos);
+   Efree(keep);
+   return nmove;
+}
+
 void
 DeskRestack(Desk * dsk)
 {
    EX_Window          *wl;
-   int                 i, num, tot;
-   EObj               *const *lst, *eo;
+   int                 i, num, nmove;
+   EObj               *const *lst;
 
    if (!dsk->stack.dirty)
       return;
@@ -1467,31 +1558,43 @@ DeskRestack(Desk * dsk)
 	goto done;
      }
 
-   /* Build the window stack, top to bottom */
-   tot = 0;
-   wl = NULL;
+   /* The window stack, top to bottom */
    lst = EobjListStackGetForDesk(&num, dsk);
 
-   /* Normal objects */
-   for (i = 0; i < num; i++)
+   nmove = DeskRestackMinimal(dsk, lst, num);
+   if (nmove < 0)
      {
-	eo = lst[i];
-	_APPEND_TO_WIN_LIST(EobjGetXwin(eo));
-	eo->stacked = 1;
+	wl = EMALLOC(EX_Window, num);
+	if (!wl)
+	   goto done;
+	for (i = 0; i < num; i++)
+	   wl[i] = EobjGetXwin(lst[i]);
+
+	if (EDebug(EDBUG_TYPE_STACKING))
+	  {
+	     for (i = 0; i < num; i++)
+		Eprintf(" win=%#10x parent=%#10x\n", wl[i],
+			EXWindowGetParent(wl[i]));
+	  }
+
+	EXRestackWindows(wl, num);
+	Efree(wl);
      }
 
    if (EDebug(EDBUG_TYPE_STACKING))
+      Eprintf("%s: %d (%d): %d objects, %s %d\n", __func__, dsk->num,
+	      dsk->stack.dirty, num, (nmove < 0) ? "restacked" : "moved",
+	      (nmove < 0) ? num : nmove);
+
+   /* Record the committed order */
+   dsk->stack.gen++;
+   for (i = 0; i < num; i++)
      {
-	Eprintf("%s: %d (%d):\n", __func__, dsk->num, dsk->stack.dirty);
-	for (i = 0; i < tot; i++)
-	   Eprintf(" win=%#10x parent=%#10x\n", wl[i],
-		   EXWindowGetParent(wl[i]));
+	lst[i]->stacked = 1;
+	lst[i]->stack_gen = dsk->stack.gen;
+	lst[i]->stack_pos = i;
      }
 
-   EXRestackWindows(wl, tot);
-
-   Efree(wl);
-
  done:
    if (dsk->stack.update_client_list)
      {
@@ -57,6 +57,7 @@ struct _desk {
       int                 dirty;
       EObj               *latest;
       char                update_client_list;
+      unsigned int        gen;	/* Restack commit generation */
    } stack;
 };
 
@@ -49,11 +49,15 @@
 #include "animation.h"
 #include "desktops.h"
 #include "ecompmgr.h"
+#if USE_GLX
+#include "eglx.h"
+#endif
 #include "emodule.h"
 #include "eobj.h"
 #include "events.h"
 #include "ewins.h"		/* EwinsManage() */
 #include "hints.h"
+#include "screen.h"
 #include "timers.h"
 #include "windowmatch.h"
 #include "xwin.h"
@@ -120,13 +124,25 @@ struct _cmhook {
    unsigned            have_shape:1;	/* Region validity - shape */
    unsigned            have_extents:1;	/* Region validity - extents */
    unsigned            have_clip:1;	/* Region validity - clip */
+   unsigned            occluded:1;	/* Covered by opaque objects above */
+   unsigned            pict_pixmap:1;	/* Picture is of pixmap, not window */
+   unsigned            parked:1;	/* Unmapped, resources kept */
+#if USE_GLX
+   unsigned            gl_dirty:1;	/* Texture must be rebound */
+#endif
    Damage              damage;
    EX_Picture          picture;
+   EX_Picture          pict_win;	/* Window picture, kept while fading out */
    EX_Picture          pict_alpha;	/* Solid, current opacity */
-   EX_SrvRegion        shape;
-   EX_SrvRegion        extents;
-   EX_SrvRegion        clip;
+   EX_Region           shape;	/* Client side */
+   EX_Region           extents;	/* Client side */
+   EX_Region           clip;	/* Client side */
+   XRectangle          ebox;	/* Extents bounding box */
    int                 shape_x, shape_y;
+#if USE_GLX
+   ETexture           *gl_tex;	/* Window contents */
+   ETexture           *gl_shadow;	/* Blurred shadow */
+#endif
 #if ENABLE_SHADOWS
    EX_Picture          shadow_alpha;	/* Solid, sharp * current opacity */
    EX_Picture          shadow_pict;	/* Blurred shaped shadow */
@@ -190,6 +206,13 @@ typedef struct {
       int                 mode;
       int                 opacity;
    } override_redirect;
+   struct {
+      char                enable;
+      unsigned int        delay;	/* Hold-off time, ms */
+   } unredir_fs;
+#if USE_GLX
+   char                use_gl;
+#endif
 } Conf_compmgr_t;
 
 Conf_compmgr_t      Conf_compmgr;
@@ -207,21 +230,50 @@ typedef struct {
    EX_Pixmap           pmap;	/* Compositing buffer */
    char                active;
    char                use_pixmap;
+#if USE_GLX
+   char                gl;	/* Painting with GL */
+   char                gl_xrender;	/* - but falling back to XRender */
+#endif
    char                reorder;
    char                ghosts;
    EObj               *eo_first;
    EObj               *eo_last;
-   EX_SrvRegion        damage;
+   EX_SrvRegion        damage;	/* Server copy of crgn_paint */
    char                got_damage;
    EX_SrvRegion        rgn_screen;
-   EX_SrvRegion        rgn_clip;
    EX_SrvRegion        rgn_tmp;	/* For temporary use */
    EX_SrvRegion        rgn_tmp2;	/* For temporary use */
+   EX_Region           crgn_screen;	/* Client side regions */
+   EX_Region           crgn_clip;
+   EX_Region           crgn_damage;	/* Accumulated damage */
+   EX_Region           crgn_paint;	/* Damage being painted */
+   EX_Region           crgn_tmp;	/* For temporary use */
+   EX_Region           crgn_tmp2;	/* For temporary use */
    int                 shadow_mode;
    float               opac_blur;	/* 0. -> 1. */
    float               opac_sharp;	/* 0. -> 1. */
+   struct {
+      EObj               *eo;	/* Unredirected fullscreen object */
+      EObj               *cand;	/* Candidate for unredirection */
+      unsigned int        t_cand;	/* Time candidate was first seen */
+      Timer              *timer;	/* Check when the delay has passed */
+   } unredir;
+   struct {
+      EX_Region           rgn;	/* Screen damage is added here */
+      void                (*func)(void);	/* and this is called */
+   } track;
 #if USE_XPRESENT
-   unsigned int        present_serial;
+   struct {
+      char                active;	/* Frames are scheduled by Present */
+      char                pending;	/* Frame presented, not completed */
+      EX_ID               eid;
+      unsigned int        serial;
+      unsigned int        t_sent;	/* Time of last present (ms) */
+      unsigned int        t_vbl;	/* Time of last completion (ms) */
+      unsigned int        t_render;	/* Last repaint time (ms) */
+      unsigned int        period;	/* Refresh period (us) */
+      unsigned long long  ust, msc;	/* Last completion UST/MSC */
+   } present;
 #endif
 } Mode_compmgr_t;
 
@@ -235,6 +287,59 @@ Mode_compmgr_t      Mode_compmgr;
 static EX_Picture   rootPicture;
 static EX_Picture   rootBuffer;
 
+/*
+ * Client side record of the screen area covered by opaque unshaped
+ * objects, built top down in ECompMgrDetermineOrder().
+ * Used to skip fully occluded objects and stop when the screen is covered.
+ */
+static struct {
+   XRectangle         *rects;
+   int                 num, nalloc;
+   char                full;
+   int                 n_occluded;
+} cover;
+
+#define COVER_BUDGET 1000	/* Max rectangle splits per check */
+
+/*
+ * Recently unmapped objects keeping their window picture and shadow,
+ * oldest first. Bounded, as the shadows hold pixel data.
+ */
+#define ECM_PARKED_MAX 32
+
+static struct {
+   EObj               *lst[ECM_PARKED_MAX];
+   int                 num;
+} parked;
+
+/* Server side object (re)builds, shown periodically when debugging */
+static struct {
+   unsigned int        t_last;	/* Start of period (ms) */
+   unsigned int        pixmap, picture, shadow, shape, alpha;
+} rebuilds;
+
+/*
+ * Paint statistics, enabled by "cm stats on", shown by "cm stats".
+ * Server time is measured with XSync on every ECM_STATS_SYNC_EVERY'th
+ * frame only.
+ */
+#define ECM_STATS_NBINS      8	/* Frame times < 1, 2, 4, ..., 64, >= 64 ms */
+#define ECM_STATS_SYNC_EVERY 32
+
+static struct {
+   unsigned int        t_start;	/* Time of reset (ms) */
+   unsigned int        frames;
+   unsigned int        hist[ECM_STATS_NBINS];
+   unsigned long long  t_frame, t_order, t_shadow, t_fade, t_sync;	/* us */
+   unsigned int        t_frame_max, t_sync_max;	/* us */
+   unsigned int        n_sync;
+   unsigned long long  painted, clipped;
+   unsigned int        reorders, occluded;
+   unsigned long long  area;	/* Damaged pixels */
+   unsigned int        fade_steps;
+} stats;
+static char         stats_on;
+
 static ESelection  *wm_cm_sel = NULL;
 
 #define OPAQUE          0xffffffff
@@ -245,9 +350,10 @@ static void         ECompMgrHandleRootEvent(Win win, XEvent * ev, void *prm);
 static void         ECompMgrHandleWindowEvent(Win win, XEvent * ev, void *prm);
 static void         ECompMgrWinInvalidate(EObj * eo, int what);
 static void         ECompMgrWinFadeEnd(EObj * eo, int done);
+static void         ECompMgrWinSetPicts(EObj * eo);
 static int          ECompMgrDetermineOrder(EObj * const *lst, int num,
 					   EObj ** first, EObj ** last,
-					   Desk * dsk, EX_SrvRegion clip);
+					   Desk * dsk, EX_Region clip);
 
 #define PIXMAP_DESTROY(pmap) \
    if (pmap != NoXID) { XFreePixmap(disp, pmap); pmap = NoXID; }
@@ -255,18 +361,22 @@ static int          ECompMgrDetermineOrder(EObj * const *lst, int num,
    if (pict != NoXID) { XRenderFreePicture(disp, pict); pict = NoXID; }
 #define REGION_DESTROY(rgn) \
    if (rgn != NoXID) { ERegionDestroy(rgn); rgn = NoXID; }
+#define CREGION_DESTROY(rgn) \
+   if (rgn) { ECRegionDestroy(rgn); rgn = NULL; }
+#define TEXTURE_DESTROY(et) \
+   if (et) { EGlCmTextureDestroy(et); et = NULL; }
 
 void
 ECompMgrWinClipToGC(EObj * eo, GC gc)
 {
-   EX_SrvRegion        rgn = Mode_compmgr.rgn_tmp2;
+   EX_Region           rgn = Mode_compmgr.crgn_tmp;
 
-   if (!eo || !eo->cmhook)
+   if (!eo || !eo->cmhook || !eo->cmhook->clip)
       return;
 
-   ERegionCopy(rgn, Mode_compmgr.rgn_screen);
-   ERegionSubtract(rgn, eo->cmhook->clip);
-   XFixesSetGCClipRegion(disp, gc, 0, 0, rgn);
+   ECRegionCopy(rgn, Mode_compmgr.crgn_screen);
+   ECRegionSubtract(rgn, eo->cmhook->clip);
+   EGCSetClipRegion(gc, rgn);
 }
 
 #if !USE_BG_WIN_ON_ALL_DESKS
@@ -354,36 +464,50 @@ ECompMgrDeskVisibility(EObj * eo, XEvent * ev)
  */
 
 static void
-ECompMgrDamageMerge(EX_SrvRegion damage)
+ECompMgrDamageMerge(EX_Region damage)
 {
    if (Mode_compmgr.got_damage)
      {
 	if (EDebug(EDBUG_TYPE_COMPMGR3))
-	   ERegionShow("ECompMgrDamageMerge add:", damage, NULL);
+	   ECRegionShow("ECompMgrDamageMerge add:", damage, NULL);
 
-	ERegionUnion(Mode_compmgr.damage, damage);
-     }
-   else if (Mode_compmgr.damage != NoXID)
-     {
-	ERegionCopy(Mode_compmgr.damage, damage);
+	ECRegionUnion(Mode_compmgr.crgn_damage, damage);
      }
    else
      {
-	Mode_compmgr.damage = ERegionClone(damage);
+	ECRegionCopy(Mode_compmgr.crgn_damage, damage);
      }
    Mode_compmgr.got_damage = 1;
 
    if (EDebug(EDBUG_TYPE_COMPMGR3))
-      ERegionShow("ECompMgrDamageMerge all:", Mode_compmgr.damage, NULL);
+      ECRegionShow("ECompMgrDamageMerge all:", Mode_compmgr.crgn_damage, NULL);
+
+   if (Mode_compmgr.track.rgn)
+     {
+	ECRegionUnion(Mode_compmgr.track.rgn, damage);
+	Mode_compmgr.track.func();
+     }
+}
+
+/*
+ * Let rgn collect all screen damage, including that of override-redirect
+ * and internal windows, and call func whenever some is added.
+ * rgn = NULL stops it.
+ */
+void
+ECompMgrDamageTrack(EX_Region rgn, void (*func)(void))
+{
+   Mode_compmgr.track.rgn = (func) ? rgn : NULL;
+   Mode_compmgr.track.func = func;
 }
 
 static void
-ECompMgrDamageMergeObject(EObj * eo, EX_SrvRegion damage)
+ECompMgrDamageMergeObject(EObj * eo, EX_Region damage)
 {
    ECmWinInfo         *cw = eo->cmhook;
    Desk               *dsk = eo->desk;
 
-   if (!Mode_compmgr.active || damage == NoXID)
+   if (!Mode_compmgr.active || !damage)
       return;
 
    if (dsk->num > 0 && !dsk->viewable && eo->ilayer < 512)
@@ -391,21 +515,26 @@ ECompMgrDamageMergeObject(EObj * eo, EX_SrvRegion damage)
 
    if (Mode_compmgr.reorder)
       ECompMgrDetermineOrder(NULL, 0, &Mode_compmgr.eo_first,
-			     &Mode_compmgr.eo_last, DeskGet(0), NoXID);
+			     &Mode_compmgr.eo_last, DeskGet(0), NULL);
 
-   damage = ERegionCopy(Mode_compmgr.rgn_tmp, damage);
+   if (cw->occluded)
+      return;			/* Covered by opaque objects */
+
+   damage = ECRegionCopy(Mode_compmgr.crgn_tmp2, damage);
 
 #if USE_CLIP_RELATIVE_TO_DESK
-   if (cw->have_clip && eo->type != EOBJ_TYPE_DESK)
-      ERegionSubtract(damage, cw->clip);
+   if (cw->have_clip && eo->type != EOBJ_TYPE_DESK &&
+       !ECRegionIsEmpty(cw->clip))
+      ECRegionSubtract(damage, cw->clip);
 #endif
 
    if (EoGetX(dsk) != 0 || EoGetY(dsk) != 0)
-      ERegionTranslate(damage, EoGetX(dsk), EoGetY(dsk));
+      ECRegionTranslate(damage, EoGetX(dsk), EoGetY(dsk));
 
 #if !USE_CLIP_RELATIVE_TO_DESK
-   if (cw->have_clip && eo->type != EOBJ_TYPE_DESK)
-      ERegionSubtract(damage, cw->clip);
+   if (cw->have_clip && eo->type != EOBJ_TYPE_DESK &&
+       !ECRegionIsEmpty(cw->clip))
+      ECRegionSubtract(damage, cw->clip);
 #endif
    if (!eo->ghost)
       Mode.events.damage_count++;
@@ -416,7 +545,7 @@ ECompMgrDamageMergeObject(EObj * eo, EX_SrvRegion damage)
 static void
 ECompMgrDamageAll(void)
 {
-   ECompMgrDamageMerge(Mode_compmgr.rgn_screen);
+   ECompMgrDamageMerge(Mode_compmgr.crgn_screen);
 }
 
 #if ENABLE_SHADOWS
@@ -428,6 +557,7 @@ static EX_Picture   transBlackPicture;
 typedef struct {
    int                 size;
    float              *data;
+   double             *sat;	/* Summed area table, (size + 1)^2 */
 } conv;
 
 static conv        *gaussianMap = NULL;
@@ -448,10 +578,13 @@ make_gaussian_map(float r)
    int                 x, y;
    float               t, g;
 
-   c = (conv *) EMALLOC(char, sizeof(conv) + size * size * sizeof(float));
+   c = (conv *) EMALLOC(char, sizeof(conv) +
+			(size + 1) * (size + 1) * sizeof(double) +
+			size * size * sizeof(float));
 
    c->size = size;
-   c->data = (float *)(c + 1);
+   c->sat = (double *)(c + 1);
+   c->data = (float *)(c->sat + (size + 1) * (size + 1));
    t = 0.f;
    for (y = 0; y < size; y++)
       for (x = 0; x < size; x++)
@@ -466,6 +599,23 @@ make_gaussian_map(float r)
 	{
 	   c->data[y * size + x] /= t;
 	}
+
+   /* sat[y][x] is the sum of data[0..y-1][0..x-1] */
+   for (x = 0; x <= size; x++)
+      c->sat[x] = 0.;
+   for (y = 0; y < size; y++)
+     {
+	double              row = 0.;
+
+	c->sat[(y + 1) * (size + 1)] = 0.;
+	for (x = 0; x < size; x++)
+	  {
+	     row += c->data[y * size + x];
+	     c->sat[(y + 1) * (size + 1) + x + 1] =
+		c->sat[y * (size + 1) + x + 1] + row;
+	  }
+     }
+
    return c;
 }
 
@@ -486,8 +636,14 @@ make_gaussian_map(float r)
  *  center  +-----+-------------------+-----+
  */
 
+typedef unsigned char (sum_func) (conv * map, float opacity, int x, int y,
+				  int width, int height);
+
+#if ENABLE_BENCHMARKS
+/* The plain summation, O(size^2) per pixel. Kept for comparison. */
 static unsigned char
-sum_gaussian(conv * map, float opacity, int x, int y, int width, int height)
+sum_gaussian_direct(conv * map, float opacity, int x, int y, int width,
+		    int height)
 {
    int                 fx, fy;
    float              *g_data;
@@ -538,9 +694,50 @@ sum_gaussian(conv * map, float opacity, int x, int y, int width, int height)
 
    return ((unsigned char)(v * opacity * 255.f));
 }
+#endif /* ENABLE_BENCHMARKS */
+
+/* Same using the summed area table, O(1) per pixel */
+static unsigned char
+sum_gaussian(conv * map, float opacity, int x, int y, int width, int height)
+{
+   const double       *sat = map->sat;
+   int                 g_size = map->size;
+   int                 stride = g_size + 1;
+   int                 center = g_size / 2;
+   int                 fx_start, fx_end;
+   int                 fy_start, fy_end;
+   double              v;
+
+   /* Filter range as in sum_gaussian_direct() */
+   fx_start = center - x;
+   if (fx_start < 0)
+      fx_start = 0;
+   fx_end = width + center - x;
+   if (fx_end > g_size)
+      fx_end = g_size;
+
+   fy_start = center - y;
+   if (fy_start < 0)
+      fy_start = 0;
+   fy_end = height + center - y;
+   if (fy_end > g_size)
+      fy_end = g_size;
+
+   if (fx_end <= fx_start || fy_end <= fy_start)
+      return 0;
+
+   v = sat[fy_end * stride + fx_end] - sat[fy_start * stride + fx_end] -
+      sat[fy_end * stride + fx_start] + sat[fy_start * stride + fx_start];
+   if (v > 1)
+      v = 1;
+   else if (v < 0)
+      v = 0;
+
+   return ((unsigned char)((float)v * opacity * 255.f));
+}
 
 static XImage      *
-make_shadow(float opacity, int width, int height)
+make_shadow(sum_func * sum, float opacity, int width, int height)
 {
    XImage             *ximage;
    unsigned char      *data;
@@ -577,7 +774,7 @@ make_shadow(float opacity, int width, int height)
    /*
     * center (fill the complete data array)
     */
-   d = sum_gaussian(gaussianMap, opacity, center, center, width, height);
+   d = sum(gaussianMap, opacity, center, center, width, height);
    memset(data, d, sheight * swidth);
 #endif
 
@@ -594,8 +791,7 @@ make_shadow(float opacity, int width, int height)
    for (y = 0; y < ylimit; y++)
       for (x = 0; x < xlimit; x++)
 	{
-	   d = sum_gaussian(gaussianMap, opacity, x - center, y - center, width,
-			    height);
+	   d = sum(gaussianMap, opacity, x - center, y - center, width, height);
 	   data[y * swidth + x] = d;
 	   data[(sheight - y - 1) * swidth + x] = d;
 	   data[(sheight - y - 1) * swidth + (swidth - x - 1)] = d;
@@ -610,8 +806,7 @@ make_shadow(float opacity, int width, int height)
      {
 	for (y = 0; y < ylimit; y++)
 	  {
-	     d = sum_gaussian(gaussianMap, opacity, center, y - center, width,
-			      height);
+	     d = sum(gaussianMap, opacity, center, y - center, width, height);
 	     memset(&data[y * swidth + gsize], d, x_diff);
 	     memset(&data[(sheight - y - 1) * swidth + gsize], d, x_diff);
 	  }
@@ -622,8 +817,7 @@ make_shadow(float opacity, int width, int height)
     */
    for (x = 0; x < xlimit; x++)
      {
-	d = sum_gaussian(gaussianMap, opacity, x - center, center, width,
-			 height);
+	d = sum(gaussianMap, opacity, x - center, center, width, height);
 	for (y = gsize; y < sheight - gsize; y++)
 	  {
 	     data[y * swidth + x] = d;
@@ -634,6 +828,110 @@ make_shadow(float opacity, int width, int height)
    return ximage;
 }
 
+/*
+ * Blurred shadow tiles.
+ * For windows at least gsize wide and high the shadow is made of constant
+ * corners, edges that only vary across the edge, and a constant center.
+ * These are taken from one small shadow made once per radius/opacity, and
+ * shadows of any such size are composed from them by the server.
+ */
+static struct {
+   int                 radius;
+   float               opacity;
+   int                 gsize;
+   EX_Picture          corners;	/* (2 * gsize + 1)^2, the small shadow */
+   EX_Picture          top, bottom, left, right, center;	/* Repeating */
+} shadow_tiles;
+
+static void
+shadow_tiles_free(void)
+{
+   PICTURE_DESTROY(shadow_tiles.corners);
+   PICTURE_DESTROY(shadow_tiles.top);
+   PICTURE_DESTROY(shadow_tiles.bottom);
+   PICTURE_DESTROY(shadow_tiles.left);
+   PICTURE_DESTROY(shadow_tiles.right);
+   PICTURE_DESTROY(shadow_tiles.center);
+}
+
+static              EX_Picture
+shadow_tile(EX_Pixmap src, GC gc, int x, int y, int w, int h)
+{
+   EX_Pixmap           pmap;
+   EX_Picture          pict;
+   XRenderPictureAttributes pa;
+
+   pmap = XCreatePixmap(disp, Mode_compmgr.root, w, h, 8);
+   XCopyArea(disp, src, pmap, gc, x, y, w, h, 0, 0);
+   pa.repeat = True;
+   pict = XRenderCreatePicture(disp, pmap,
+			       XRenderFindStandardFormat(disp, PictStandardA8),
+			       CPRepeat, &pa);
+   XFreePixmap(disp, pmap);
+
+   return pict;
+}
+
+static int
+shadow_tiles_make(float opacity)
+{
+   XImage             *ximage;
+   EX_Pixmap           pmap;
+   GC                  gc;
+   int                 gs, ts;
+
+   if (shadow_tiles.corners != NoXID &&
+       shadow_tiles.radius == Conf_compmgr.shadows.blur.radius &&
+       shadow_tiles.opacity == opacity &&
+       shadow_tiles.gsize == gaussianMap->size)
+      return 0;
+
+   shadow_tiles_free();
+
+   gs = gaussianMap->size;
+   ximage = make_shadow(sum_gaussian, opacity, gs + 1, gs + 1);
+   if (!ximage)
+      return -1;
+   ts = ximage->width;		/* 2 * gs + 1 */
+
+   pmap = XCreatePixmap(disp, Mode_compmgr.root, ts, ts, 8);
+   gc = XCreateGC(disp, pmap, 0, 0);
+   XPutImage(disp, pmap, gc, ximage, 0, 0, 0, 0, ts, ts);
+   XDestroyImage(ximage);
+
+   shadow_tiles.corners =
+      XRenderCreatePicture(disp, pmap,
+			   XRenderFindStandardFormat(disp, PictStandardA8),
+			   0, 0);
+   shadow_tiles.top = shadow_tile(pmap, gc, gs, 0, 1, gs);
+   shadow_tiles.bottom = shadow_tile(pmap, gc, gs, gs + 1, 1, gs);
+   shadow_tiles.left = shadow_tile(pmap, gc, 0, gs, gs, 1);
+   shadow_tiles.right = shadow_tile(pmap, gc, gs + 1, gs, gs, 1);
+   shadow_tiles.center = shadow_tile(pmap, gc, gs, gs, 1, 1);
+
+   XFreeGC(disp, gc);
+   XFreePixmap(disp, pmap);
+
+   shadow_tiles.radius = Conf_compmgr.shadows.blur.radius;
+   shadow_tiles.opacity = opacity;
+   shadow_tiles.gsize = gs;
+
+   D1printf("%s: radius=%d opacity=%.2f size=%d\n", __func__,
+	    shadow_tiles.radius, opacity, gs);
+
+   return 0;
+}
+
+static void
+shadow_tile_put(EX_Picture src, EX_Picture dst, int sx, int sy,
+		int dx, int dy, int w, int h)
+{
+   if (w <= 0 || h <= 0)
+      return;
+   XRenderComposite(disp, PictOpSrc, src, NoXID, dst, sx, sy, 0, 0,
+		    dx, dy, w, h);
+}
+
 static              EX_Picture
 shadow_picture(float opacity, int width, int height, int *wp, int *hp)
 {
@@ -641,8 +939,44 @@ shadow_picture(float opacity, int width, int height, int *wp, int *hp)
    EX_Pixmap           shadowPixmap;
    EX_Picture          shadowPicture;
    GC                  gc;
+   int                 gs;
+
+   gs = gaussianMap->size;
+   if (gs > 0 && width >= gs && height >= gs && shadow_tiles_make(opacity) == 0)
+     {
+	/* Compose from tiles, no client side work */
+	*wp = width + gs;
+	*hp = height + gs;
+	shadowPixmap = XCreatePixmap(disp, Mode_compmgr.root, *wp, *hp, 8);
+	shadowPicture =
+	   XRenderCreatePicture(disp, shadowPixmap,
+				XRenderFindStandardFormat(disp, PictStandardA8),
+				0, 0);
+	XFreePixmap(disp, shadowPixmap);
+
+	shadow_tile_put(shadow_tiles.corners, shadowPicture,
+			0, 0, 0, 0, gs, gs);
+	shadow_tile_put(shadow_tiles.corners, shadowPicture,
+			gs + 1, 0, width, 0, gs, gs);
+	shadow_tile_put(shadow_tiles.corners, shadowPicture,
+			0, gs + 1, 0, height, gs, gs);
+	shadow_tile_put(shadow_tiles.corners, shadowPicture,
+			gs + 1, gs + 1, width, height, gs, gs);
+	shadow_tile_put(shadow_tiles.top, shadowPicture,
+			0, 0, gs, 0, width - gs, gs);
+	shadow_tile_put(shadow_tiles.bottom, shadowPicture,
+			0, 0, gs, height, width - gs, gs);
+	shadow_tile_put(shadow_tiles.left, shadowPicture,
+			0, 0, 0, gs, gs, height - gs);
+	shadow_tile_put(shadow_tiles.right, shadowPicture,
+			0, 0, width, gs, gs, height - gs);
+	shadow_tile_put(shadow_tiles.center, shadowPicture,
+			0, 0, gs, gs, width - gs, height - gs);
+
+	return shadowPicture;
+     }
 
-   shadowImage = make_shadow(opacity, width, height);
+   shadowImage = make_shadow(sum_gaussian, opacity, width, height);
    if (!shadowImage)
       return NoXID;
 
@@ -665,6 +999,64 @@ shadow_picture(float opacity, int width, int height, int *wp, int *hp)
    return shadowPicture;
 }
 
+#if ENABLE_BENCHMARKS
+static void
+ECompMgrShadowBench(void)
+{
+   static const int    radii[] = { 3, 5, 8, 12, 16, 20 };
+   static const int    sizes[][2] = { {100, 80}, {400, 300}, {1600, 1200} };
+   conv               *map_save;
+   XImage             *im1, *im2;
+   unsigned int        t0, t1, t2;
+   int                 i, j, k, n, d, ndiff, dmax;
+
+   map_save = gaussianMap;
+
+   for (i = 0; i < (int)(sizeof(radii) / sizeof(int)); i++)
+     {
+	gaussianMap = make_gaussian_map((float)radii[i]);
+	for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); j++)
+	  {
+	     t0 = GetTimeUs();
+	     im1 = make_shadow(sum_gaussian_direct, 1.f, sizes[j][0],
+			       sizes[j][1]);
+	     t1 = GetTimeUs();
+	     im2 = make_shadow(sum_gaussian, 1.f, sizes[j][0], sizes[j][1]);
+	     t2 = GetTimeUs();
+	     if (!im1 || !im2)
+	       {
+		  if (im1)
+		     XDestroyImage(im1);
+		  if (im2)
+		     XDestroyImage(im2);
+		  break;
+	       }
+
+	     n = im1->width * im1->height;
+	     for (k = ndiff = dmax = 0; k < n; k++)
+	       {
+		  d = abs((unsigned char)im1->data[k] -
+			  (unsigned char)im2->data[k]);
+		  if (d == 0)
+		     continue;
+		  ndiff++;
+		  if (dmax < d)
+		     dmax = d;
+	       }
+	     IpcPrintf("radius %2d %4dx%-4d  direct %8.3f ms  sat %8.3f ms"
+		       "  differ %d (max %d)\n", radii[i],
+		       sizes[j][0], sizes[j][1], 1e-3 * (t1 - t0),
+		       1e-3 * (t2 - t1), ndiff, dmax);
+	     XDestroyImage(im1);
+	     XDestroyImage(im2);
+	  }
+	Efree(gaussianMap);
+     }
+
+   gaussianMap = map_save;
+}
+#endif /* ENABLE_BENCHMARKS */
+
 #endif /* ENABLE_SHADOWS */
 
 static void         ECompMgrWinSetShape(EObj * eo);
@@ -709,8 +1101,8 @@ ECompMgrWinSetExtents(EObj * eo)
 	r.height = cw->rch;
      }
 
-   if (cw->extents == NoXID)
-      cw->extents = ERegionCreate();
+   if (!cw->extents)
+      cw->extents = ECRegionCreate();
 
 #if ENABLE_SHADOWS
    cw->has_shadow = (Mode_compmgr.shadow_mode != ECM_SHADOWS_OFF) &&
@@ -745,11 +1137,10 @@ ECompMgrWinSetExtents(EObj * eo)
 
 	cw->shadow_dx = Conf_compmgr.shadows.offset_x - gaussianMap->size / 2;
 	cw->shadow_dy = Conf_compmgr.shadows.offset_y - gaussianMap->size / 2;
-	if (!cw->shadow_pict)
-	   cw->shadow_pict = shadow_picture(Mode_compmgr.opac_blur,
-					    cw->rcw, cw->rch,
-					    &cw->shadow_width,
-					    &cw->shadow_height);
+	/* The shadow picture itself is built when first painted, so
+	 * intermediate sizes while resizing are never rendered */
+	cw->shadow_width = cw->rcw + gaussianMap->size;
+	cw->shadow_height = cw->rch + gaussianMap->size;
 	break;
      }
    sr.x = cw->rcx + cw->shadow_dx;
@@ -771,25 +1162,31 @@ ECompMgrWinSetExtents(EObj * eo)
    if (sr.y + sr.height > r.y + r.height)
       r.height = sr.y + sr.height - r.y;
 
-   ERegionSetRect(cw->extents, r.x, r.y, r.width, r.height);
+   ECRegionSetRect(cw->extents, r.x, r.y, r.width, r.height);
    goto done;
 
  skip_shadow:
+   cw->has_shadow = 0;
 #endif
 
    /* No shadow - extents = shape */
    if (!cw->have_shape)
       ECompMgrWinSetShape(eo);
-   ERegionCopy(cw->extents, cw->shape);
+   ECRegionCopy(cw->extents, cw->shape);
+   r.x = EobjGetX(eo);
+   r.y = EobjGetY(eo);
+   r.width = EobjGetW(eo) + 2 * bw;
+   r.height = EobjGetH(eo) + 2 * bw;
 
  done:
+   cw->ebox = r;
    cw->have_extents = 1;
 
    D1printf("%s: %#x %d %d %d %d\n", __func__, EobjGetXwin(eo),
 	    r.x, r.y, r.width, r.height);
 
    if (EDebug(EDBUG_TYPE_COMPMGR2))
-      ERegionShow("extents", cw->extents, NULL);
+      ECRegionShow("extents", cw->extents, NULL);
 }
 
 /* Region of shaped window in screen coordinates */
@@ -799,23 +1196,20 @@ ECompMgrWinSetShape(EObj * eo)
    ECmWinInfo         *cw = eo->cmhook;
    int                 x, y;
 
-   if (cw->shape == NoXID)
+   if (!cw->shape)
      {
-#if 0				/* FIXME - TBD */
-	/* If the window shape is changed on OR windows, cw->shape set below
-	 * may not reflect the shape change. Adding a sync fixes things in
-	 * some situations. */
-	if (eo->type == EOBJ_TYPE_EXT)
-	   ESync(0);
-#endif
-	cw->shape = ERegionCreateFromWindow(EobjGetWin(eo));
+	/* Built from the shape rectangles already tracked for the window
+	 * (see EShapeUpdate()), so no server round trip is needed. */
+	cw->shape = ECRegionCreate();
+	ECRegionSetFromShape(cw->shape, EobjGetWin(eo));
+	rebuilds.shape++;
 
 	if (WinIsShaped(EobjGetWin(eo)))
 	  {
 	     /* Intersect with window size to get effective bounding region */
-	     ERegionSetRect(Mode_compmgr.rgn_tmp,
-			    0, 0, EobjGetW(eo), EobjGetH(eo));
-	     ERegionIntersect(cw->shape, Mode_compmgr.rgn_tmp);
+	     ECRegionSetRect(Mode_compmgr.crgn_tmp,
+			     0, 0, EobjGetW(eo), EobjGetH(eo));
+	     ECRegionIntersect(cw->shape, Mode_compmgr.crgn_tmp);
 	  }
 	x = EobjGetX(eo) + EobjGetBW(eo);
 	y = EobjGetY(eo) + EobjGetBW(eo);
@@ -826,7 +1220,7 @@ ECompMgrWinSetShape(EObj * eo)
 	y = EobjGetY(eo) + EobjGetBW(eo) - cw->shape_y;
      }
 
-   ERegionTranslate(cw->shape, x, y);
+   ECRegionTranslate(cw->shape, x, y);
 
    cw->shape_x = EobjGetX(eo) + EobjGetBW(eo);
    cw->shape_y = EobjGetY(eo) + EobjGetBW(eo);
@@ -835,7 +1229,7 @@ ECompMgrWinSetShape(EObj * eo)
    D1printf("%s: %#x: %d %d\n", __func__, EobjGetXwin(eo),
 	    cw->shape_x, cw->shape_y);
    if (EDebug(EDBUG_TYPE_COMPMGR2))
-      ERegionShow("shape", cw->shape, NULL);
+      ECRegionShow("shape", cw->shape, NULL);
 }
 
 EX_Pixmap
@@ -853,6 +1247,7 @@ ECompMgrWinGetPixmap(const EObj * eo)
       return NoXID;
 
    cw->pixmap = EWindowGetPixmap(EobjGetWin(eo));
+   rebuilds.pixmap++;
 
    return cw->pixmap;
 }
@@ -863,6 +1258,30 @@ ECompMgrWinGetAlphaPict(const EObj * eo)
    return (eo->cmhook) ? eo->cmhook->pict_alpha : NoXID;
 }
 
+/* Get window contents picture, e.g. for pager thumbnails */
+EX_Picture
+ECompMgrWinGetPicture(EObj * eo)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+
+   if (!cw || eo->noredir || !eo->shown)
+      return NoXID;
+
+   /* Windows on hidden desks have no contents, unless held by a pixmap */
+   if (cw->picture == NoXID)
+     {
+	if (!eo->desk->viewable)
+	   return NoXID;
+	ECompMgrWinSetPicts(eo);
+     }
+   else if (!cw->pict_pixmap && !eo->desk->viewable)
+     {
+	return NoXID;
+     }
+
+   return cw->picture;
+}
+
 static void
 ECompMgrWinInvalidate(EObj * eo, int what)
 {
@@ -873,24 +1292,36 @@ ECompMgrWinInvalidate(EObj * eo, int what)
 
    D1printf("%s: %#x: %#x\n", __func__, EobjGetXwin(eo), what);
 
+#if USE_GLX
+   /* Release GLX pixmaps before the pixmaps they refer to */
+   if (what & (INV_SIZE | INV_PIXMAP | INV_PICTURE))
+      TEXTURE_DESTROY(cw->gl_tex);
+   if (what & (INV_SIZE | INV_SHADOW))
+      TEXTURE_DESTROY(cw->gl_shadow);
+#endif
+
    if ((what & (INV_SIZE | INV_PIXMAP)) && cw->pixmap != NoXID)
      {
 	XFreePixmap(disp, cw->pixmap);
 	cw->pixmap = NoXID;
-	if (Mode_compmgr.use_pixmap)
-	   what |= INV_PICTURE;
+	/* A picture of the pixmap goes with it, one of the window is kept */
+	if (cw->pict_pixmap)
+	   PICTURE_DESTROY(cw->picture);
 #if USE_GLX
 	EobjTextureInvalidate(eo);
 #endif
      }
 
    if (what & (INV_SIZE | INV_SHAPE))
-      REGION_DESTROY(cw->shape);
+      CREGION_DESTROY(cw->shape);
    if (what & INV_GEOM)
       cw->have_shape = 0;
 
    if (what & INV_PICTURE)
-      PICTURE_DESTROY(cw->picture);
+     {
+	PICTURE_DESTROY(cw->picture);
+	PICTURE_DESTROY(cw->pict_win);
+     }
 
    if (what & INV_OPACITY)
       PICTURE_DESTROY(cw->pict_alpha);
@@ -909,11 +1340,56 @@ ECompMgrWinInvalidate(EObj * eo, int what)
       cw->have_extents = 0;
 }
 
+/*
+ * Unmapped objects keep their window picture and shadow for a while so
+ * e.g. iconify/deiconify does not have to rebuild them.
+ */
+static void
+ECompMgrWinUnpark(EObj * eo)
+{
+   int                 i;
+
+   if (!eo->cmhook->parked)
+      return;
+   eo->cmhook->parked = 0;
+
+   for (i = 0; i < parked.num; i++)
+     {
+	if (parked.lst[i] != eo)
+	   continue;
+	parked.num--;
+	memmove(parked.lst + i, parked.lst + i + 1,
+		(parked.num - i) * sizeof(EObj *));
+	break;
+     }
+}
+
+static void
+ECompMgrWinPark(EObj * eo)
+{
+   EObj               *eo_old;
+
+   if (eo->cmhook->parked)
+      return;
+
+   if (parked.num >= ECM_PARKED_MAX)
+     {
+	/* Drop the oldest */
+	eo_old = parked.lst[0];
+	ECompMgrWinUnpark(eo_old);
+	ECompMgrWinInvalidate(eo_old, INV_PICTURE | INV_SHADOW);
+     }
+
+   eo->cmhook->parked = 1;
+   parked.lst[parked.num++] = eo;
+}
+
+static void         ECompMgrWinSetMode(EObj * eo);
+
 void
 ECompMgrWinSetOpacity(EObj * eo, unsigned int opacity)
 {
    ECmWinInfo         *cw = eo->cmhook;
-   int                 mode;
 
    if (!cw || cw->opacity == opacity)
       return;
@@ -928,6 +1404,15 @@ ECompMgrWinSetOpacity(EObj * eo, unsigned int opacity)
    /* Invalidate stuff changed by opacity */
    ECompMgrWinInvalidate(eo, INV_OPACITY);
 
+   ECompMgrWinSetMode(eo);
+}
+
+static void
+ECompMgrWinSetMode(EObj * eo)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+   int                 mode;
+
    if (eo->noredir)
       mode = WINDOW_UNREDIR;
    else if (EobjGetWin(eo)->argb)
@@ -943,54 +1428,239 @@ ECompMgrWinSetOpacity(EObj * eo, unsigned int opacity)
    cw->mode = mode;
 }
 
+/*
+ * Fullscreen unredirection
+ *
+ * A topmost, opaque client covering an entire head is unredirected so it
+ * is drawn directly by the server instead of being composited on every
+ * frame. It is redirected again as soon as any of the conditions fail.
+ */
+
 static int
-doECompMgrWinFade(EObj * eo, int run, void *data __UNUSED__)
+ECompMgrWinIsFullscreen(EObj * eo)
 {
-   ECmWinInfo         *cw;
-   unsigned int        op, step;
-
-   cw = eo->cmhook;
-   op = cw->opacity_to;
+   ECmWinInfo         *cw = eo->cmhook;
+   int                 x, y, w, h, sx, sy, sw, sh;
 
-#if DEBUG_OPACITY
-   Eprintf("%s %#x: %u/%u, %#x->%#x\n", __func__, EobjGetXwin(eo),
-	   eo->fading, cw->fadeout, cw->opacity, op);
+   if (eo->type != EOBJ_TYPE_EWIN || !eo->shown || eo->ghost ||
+       eo->fading || cw->fadeout)
+      return 0;
+   if (eo->noredir && eo != Mode_compmgr.unredir.eo)
+      return 0;			/* Unredirected by configuration */
+   if (EobjGetWin(eo)->argb || cw->opacity != OPAQUE ||
+       WinIsShaped(EobjGetWin(eo)))
+      return 0;
+#if ENABLE_SHADOWS
+   if (cw->has_shadow)
+      return 0;
 #endif
-   if (!eo->fading)
-      goto done;
 
-   eo->fading = cw->fadeout;
+   x = EoGetX(eo->desk) + EobjGetX(eo);
+   y = EoGetY(eo->desk) + EobjGetY(eo);
+   w = EobjGetW(eo) + 2 * EobjGetBW(eo);
+   h = EobjGetH(eo) + 2 * EobjGetBW(eo);
+   ScreenGetGeometry(x + w / 2, y + h / 2, &sx, &sy, &sw, &sh);
 
-   step = Conf_compmgr.fading.time;
-   if (step == 0)
-      step = 1;
-   step = run * (0xffffffff / step);
-   if (op == cw->opacity)
+   return x <= sx && y <= sy && x + w >= sx + sw && y + h >= sy + sh;
+}
+
+/* The unredirected fullscreen window is drawn by the server */
+static void
+ECompMgrUnredirSubtract(EX_Region rgn)
+{
+   EObj               *eo = Mode_compmgr.unredir.eo;
+   EX_Region           tmp;
+
+   if (!eo)
+      return;
+
+   tmp = ECRegionCopy(Mode_compmgr.crgn_tmp2, eo->cmhook->extents);
+   ECRegionTranslate(tmp, EoGetX(eo->desk), EoGetY(eo->desk));
+   ECRegionSubtract(rgn, tmp);
+}
+
+#if USE_COMPOSITE_OVERLAY_WINDOW
+/* Let the unredirected window (if any) show through the overlay window */
+static void
+ECompMgrUnredirShapeUpdate(EObj * eo)
+{
+   EX_SrvRegion        rgn;
+
+   if (Mode_compmgr.cow == NoXID)
+      return;
+
+   if (eo)
      {
-	op = eo->opacity;
-	ECompMgrWinFadeEnd(eo, 0);
+	ECRegionCopy(Mode_compmgr.crgn_tmp2, eo->cmhook->extents);
+	ECRegionTranslate(Mode_compmgr.crgn_tmp2,
+			  EoGetX(eo->desk), EoGetY(eo->desk));
+	ECRegionUpload(Mode_compmgr.rgn_tmp2, Mode_compmgr.crgn_tmp2);
+	rgn = ERegionCopy(Mode_compmgr.rgn_tmp, Mode_compmgr.rgn_screen);
+	ERegionSubtract(rgn, Mode_compmgr.rgn_tmp2);
      }
-   else if (op > cw->opacity)
+   else
      {
-	if (op - cw->opacity > step)
-	  {
-	     op = cw->opacity + step;
-	     eo->fading = 1;
-	  }
+	rgn = NoXID;
+     }
+   XFixesSetWindowShapeRegion(disp, Mode_compmgr.cow, ShapeBounding,
+			      0, 0, rgn);
+}
+#else
+#define ECompMgrUnredirShapeUpdate(eo)
+#endif
+
+static void
+ECompMgrWinSetUnredirected(EObj * eo, int unredir)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+
+   D1printf("%s: %#x unredir=%d: %s\n", __func__, EobjGetXwin(eo), unredir,
+	    EobjGetName(eo));
+
+   if (unredir)
+     {
+	if (cw->damage != NoXID)
+	   XDamageDestroy(disp, cw->damage);
+	cw->damage = NoXID;
+	XCompositeUnredirectWindow(disp, EobjGetXwin(eo),
+				   CompositeRedirectManual);
+	eo->noredir = 1;
+	Mode_compmgr.unredir.eo = eo;
      }
    else
      {
-	if (cw->opacity - op > step)
+	if (!eo->gone)
 	  {
-	     op = cw->opacity - step;
-	     eo->fading = 1;
+	     XCompositeRedirectWindow(disp, EobjGetXwin(eo),
+				      CompositeRedirectManual);
+	     cw->damage_sequence = NextRequest(disp);
+	     cw->damage =
+		XDamageCreate(disp, EobjGetXwin(eo), XDamageReportBoundingBox);
 	  }
+	eo->noredir = 0;
+	Mode_compmgr.unredir.eo = NULL;
+	Mode_compmgr.unredir.t_cand = GetTimeMs();
      }
 
-#if DEBUG_OPACITY
-   Eprintf("%s %#x: %#x\n", __func__, EobjGetXwin(eo), op);
+   ECompMgrUnredirShapeUpdate(unredir ? eo : NULL);
+
+   ECompMgrWinInvalidate(eo, INV_PIXMAP | INV_PICTURE);
+   ECompMgrWinSetMode(eo);
+   ECompMgrDamageMergeObject(eo, cw->extents);
+}
+
+static int          ECompMgrUnredirTimeout(void *data);
+
+/* Called after each repaint with the top object in paint order */
+static void
+ECompMgrUnredirCheck(EObj * top)
+{
+   EObj               *eo = Mode_compmgr.unredir.eo;
+   unsigned int        tnow, dt;
+
+   TIMER_DEL(Mode_compmgr.unredir.timer);
+
+   if (!Conf_compmgr.unredir_fs.enable || Mode_compmgr.mode == ECM_MODE_AUTO
+       || Mode_compmgr.ghosts || (top && !ECompMgrWinIsFullscreen(top)))
+      top = NULL;
+
+   if (eo)
+     {
+	/* Redirect immediately when no longer applicable */
+	if (eo != top)
+	   ECompMgrWinSetUnredirected(eo, 0);
+	return;
+     }
+
+   tnow = GetTimeMs();
+   if (top != Mode_compmgr.unredir.cand)
+     {
+	Mode_compmgr.unredir.cand = top;
+	Mode_compmgr.unredir.t_cand = tnow;
+     }
+   if (!top)
+      return;
+
+   /* Only unredirect when the conditions have held for a while */
+   dt = tnow - Mode_compmgr.unredir.t_cand;
+   if (dt >= (unsigned int)Conf_compmgr.unredir_fs.delay)
+      ECompMgrWinSetUnredirected(top, 1);
+   else				/* Static screen - there may be no more repaints */
+      TIMER_ADD(Mode_compmgr.unredir.timer,
+		Conf_compmgr.unredir_fs.delay - dt, ECompMgrUnredirTimeout,
+		NULL);
+}
+
+static int
+ECompMgrUnredirTimeout(void *data __UNUSED__)
+{
+   Mode_compmgr.unredir.timer = NULL;
+
+   if (!Mode_compmgr.active)
+      return 0;
+
+   if (Mode_compmgr.reorder)
+      ECompMgrDetermineOrder(NULL, 0, &Mode_compmgr.eo_first,
+			     &Mode_compmgr.eo_last, DeskGet(0), NULL);
+   ECompMgrUnredirCheck(Mode_compmgr.eo_first);
+
+   return 0;
+}
+
+static int
+doECompMgrWinFade(EObj * eo, int run, void *data __UNUSED__)
+{
+   ECmWinInfo         *cw;
+   unsigned int        op, step, t0;
+
+   t0 = (stats_on) ? GetTimeUs() : 0;
+   cw = eo->cmhook;
+   op = cw->opacity_to;
+
+#if DEBUG_OPACITY
+   Eprintf("%s %#x: %u/%u, %#x->%#x\n", __func__, EobjGetXwin(eo),
+	   eo->fading, cw->fadeout, cw->opacity, op);
+#endif
+   if (!eo->fading)
+      goto done;
+
+   eo->fading = cw->fadeout;
+
+   step = Conf_compmgr.fading.time;
+   if (step == 0)
+      step = 1;
+   step = run * (0xffffffff / step);
+   if (op == cw->opacity)
+     {
+	op = eo->opacity;
+	ECompMgrWinFadeEnd(eo, 0);
+     }
+   else if (op > cw->opacity)
+     {
+	if (op - cw->opacity > step)
+	  {
+	     op = cw->opacity + step;
+	     eo->fading = 1;
+	  }
+     }
+   else
+     {
+	if (cw->opacity - op > step)
+	  {
+	     op = cw->opacity - step;
+	     eo->fading = 1;
+	  }
+     }
+
+#if DEBUG_OPACITY
+   Eprintf("%s %#x: %#x\n", __func__, EobjGetXwin(eo), op);
 #endif
    ECompMgrWinSetOpacity(eo, op);
+   if (stats_on)
+     {
+	stats.t_fade += GetTimeUs() - t0;
+	stats.fade_steps++;
+     }
 
    if (eo->fading)
       return 0;
@@ -1061,7 +1731,16 @@ ECompMgrWinFadeEnd(EObj * eo, int done)
    if (cw->fadeout)
      {
 	cw->fadeout = 0;
-	ECompMgrWinInvalidate(eo, INV_PIXMAP | INV_PICTURE);
+	ECompMgrWinInvalidate(eo, INV_PIXMAP);
+	if (cw->picture == NoXID)
+	  {
+	     /* Back to the window picture kept while fading out */
+	     cw->picture = cw->pict_win;
+	     cw->pict_win = NoXID;
+	     cw->pict_pixmap = 0;
+	  }
+	if (!eo->shown)
+	   ECompMgrWinPark(eo);
 	ECompMgrDamageMergeObject(eo, cw->extents);
 	_ECM_SET_CLIP_CHANGED();
      }
@@ -1103,6 +1782,8 @@ ECompMgrWinMap(EObj * eo)
 
    D1printf("%s: %#x\n", __func__, EobjGetXwin(eo));
 
+   ECompMgrWinUnpark(eo);
+
    if (!cw->have_extents)
       ECompMgrWinSetExtents(eo);
 
@@ -1126,16 +1807,31 @@ ECompMgrWinUnmap(EObj * eo)
 
    fadeout = Conf_compmgr.fading.enable && eo->fade && !eo->gone;
 
+   if (eo == Mode_compmgr.unredir.eo)
+     {
+	ECompMgrWinSetUnredirected(eo, 0);
+	fadeout = 0;		/* No pixmap to fade out */
+     }
+
    ECompMgrDamageMergeObject(eo, cw->extents);
    _ECM_SET_STACK_CHANGED();
 
    if (fadeout)
      {
-	ECompMgrWinInvalidate(eo, INV_PICTURE);
+	if (!cw->pict_pixmap)
+	  {
+	     /* Fade out from the pixmap, keep the window picture */
+	     PICTURE_DESTROY(cw->pict_win);
+	     cw->pict_win = cw->picture;
+	     cw->picture = NoXID;
+	  }
 	ECompMgrWinFadeOut(eo);
      }
    else
-      ECompMgrWinInvalidate(eo, INV_PIXMAP);
+     {
+	ECompMgrWinInvalidate(eo, INV_PIXMAP);
+	ECompMgrWinPark(eo);
+     }
 }
 
 static void
@@ -1147,6 +1843,7 @@ ECompMgrWinSetPicts(EObj * eo)
        (Mode_compmgr.use_pixmap || (eo->fade && Conf_compmgr.fading.enable)))
      {
 	cw->pixmap = EWindowGetPixmap(EobjGetWin(eo));
+	rebuilds.pixmap++;
 	D1printf("%s: %#x: Pmap=%#x\n", __func__, EobjGetXwin(eo), cw->pixmap);
      }
 
@@ -1160,6 +1857,8 @@ ECompMgrWinSetPicts(EObj * eo)
 	   return;
 
 	cw->picture = EPictureCreateII(EobjGetWin(eo), draw);
+	cw->pict_pixmap = draw == cw->pixmap;
+	rebuilds.picture++;
 	D1printf("%s: %#x: Pict=%#x (drawable=%#x)\n", __func__,
 		 EobjGetXwin(eo), cw->picture, draw);
 
@@ -1230,7 +1929,7 @@ ECompMgrWinNew(EObj * eo)
 				    CompositeRedirectManual);
 	cw->damage_sequence = NextRequest(disp);
 	cw->damage =
-	   XDamageCreate(disp, EobjGetXwin(eo), XDamageReportNonEmpty);
+	   XDamageCreate(disp, EobjGetXwin(eo), XDamageReportBoundingBox);
      }
 
    if (eo->type == EOBJ_TYPE_EXT)
@@ -1280,7 +1979,7 @@ ECompMgrWinMoveResize(EObj * eo, int change_xy, int change_wh, int change_bw)
      }
 
    if (EDebug(EDBUG_TYPE_COMPMGR3))
-      ERegionShow("old-extents:", cw->extents, NULL);
+      ECRegionShow("old-extents:", cw->extents, NULL);
 
 #if 0				/* FIXME - We shouldn't have to update clip if transparent */
    if (cw->mode == WINDOW_UNREDIR || cw->mode == WINDOW_SOLID)
@@ -1290,12 +1989,12 @@ ECompMgrWinMoveResize(EObj * eo, int change_xy, int change_wh, int change_bw)
    if (cw->have_extents)
      {
 	/* Invalidate old window region */
-	ERegionCopy(Mode_compmgr.rgn_tmp2, cw->extents);
+	ECRegionCopy(Mode_compmgr.crgn_tmp2, cw->extents);
 	ECompMgrWinInvalidate(eo, invalidate);
 	/* Invalidate new window region */
 	ECompMgrWinSetExtents(eo);
-	ERegionUnion(Mode_compmgr.rgn_tmp2, cw->extents);
-	ECompMgrDamageMergeObject(eo, Mode_compmgr.rgn_tmp2);
+	ECRegionUnion(Mode_compmgr.crgn_tmp2, cw->extents);
+	ECompMgrDamageMergeObject(eo, Mode_compmgr.crgn_tmp2);
      }
    else
      {
@@ -1304,6 +2003,10 @@ ECompMgrWinMoveResize(EObj * eo, int change_xy, int change_wh, int change_bw)
 	ECompMgrWinSetExtents(eo);
 	ECompMgrDamageMergeObject(eo, cw->extents);
      }
+
+   /* Until the next repaint redirects it, if no longer fullscreen */
+   if (eo == Mode_compmgr.unredir.eo)
+      ECompMgrUnredirShapeUpdate(eo);
 }
 
 void
@@ -1367,8 +2070,7 @@ ECompMgrWinReparent(EObj * eo, Desk * dsk, int change_xy)
 {
    ECmWinInfo         *cw = eo->cmhook;
 
-   D1printf("%s: %#x %#x d=%d->%d x,y=%d,%d %d\n", __func__,
-	    EobjGetXwin(eo), cw->extents,
+   D1printf("%s: %#x d=%d->%d x,y=%d,%d %d\n", __func__, EobjGetXwin(eo),
 	    (eo->desk) ? (int)eo->desk->num : -1, dsk->num,
 	    EobjGetX(eo), EobjGetY(eo), change_xy);
 
@@ -1381,7 +2083,7 @@ ECompMgrWinReparent(EObj * eo, Desk * dsk, int change_xy)
 
    /* Invalidate old window region */
    if (EDebug(EDBUG_TYPE_COMPMGR3))
-      ERegionShow("old-extents:", cw->extents, NULL);
+      ECRegionShow("old-extents:", cw->extents, NULL);
    ECompMgrDamageMergeObject(eo, cw->extents);
    if (change_xy)
      {
@@ -1390,7 +2092,7 @@ ECompMgrWinReparent(EObj * eo, Desk * dsk, int change_xy)
 	/* Find new window region */
 	ECompMgrWinSetExtents(eo);
      }
-   eo->desk = dsk;
+   EobjSetDesk(eo, dsk);
    _ECM_SET_STACK_CHANGED();
    ECompMgrDamageMergeObject(eo, cw->extents);
    ECompMgrWinInvalidate(eo, INV_PIXMAP);
@@ -1413,7 +2115,7 @@ ECompMgrWinChangeShape(EObj * eo)
 
    EShapeUpdate(EobjGetWin(eo));
 
-   if (cw->extents == NoXID)
+   if (!cw->extents)
       return;
 
    ECompMgrDamageMergeObject(eo, cw->extents);
@@ -1449,6 +2151,12 @@ ECompMgrWinDel(EObj * eo)
 
    if (eo->fading)
       ECompMgrWinFadeEnd(eo, 1);
+   ECompMgrWinUnpark(eo);
+
+   if (eo == Mode_compmgr.unredir.eo)
+      ECompMgrWinSetUnredirected(eo, 0);
+   if (eo == Mode_compmgr.unredir.cand)
+      Mode_compmgr.unredir.cand = NULL;
 
    EventCallbackUnregister(EobjGetWin(eo), ECompMgrHandleWindowEvent, eo);
 
@@ -1475,8 +2183,8 @@ ECompMgrWinDel(EObj * eo)
      }
 
    ECompMgrWinInvalidate(eo, INV_ALL);
-   REGION_DESTROY(cw->extents);
-   REGION_DESTROY(cw->clip);
+   CREGION_DESTROY(cw->extents);
+   CREGION_DESTROY(cw->clip);
 
    Efree(eo->cmhook);
    eo->cmhook = NULL;
@@ -1489,7 +2197,7 @@ ECompMgrWinDamage(EObj * eo, XEvent * ev)
 {
    ECmWinInfo         *cw = eo->cmhook;
    XDamageNotifyEvent *de = (XDamageNotifyEvent *) ev;
-   EX_SrvRegion        parts;
+   EX_Region           parts;
 
    D2printf("%s: %#lx %#x damaged=%d %d,%d %dx%d\n", __func__,
 	    ev->xany.window, EobjGetXwin(eo), cw->damaged,
@@ -1503,12 +2211,18 @@ ECompMgrWinDamage(EObj * eo, XEvent * ev)
      }
    else
      {
-	parts = Mode_compmgr.rgn_tmp;
-	XDamageSubtract(disp, cw->damage, NoXID, parts);
-	ERegionTranslate(parts, EobjGetX(eo) + EobjGetBW(eo),
-			 EobjGetY(eo) + EobjGetBW(eo));
+	/* Reported at bounding box level, so the area covers all damage
+	 * since the last subtract */
+	parts = Mode_compmgr.crgn_tmp2;
+	ECRegionSetRect(parts, EobjGetX(eo) + EobjGetBW(eo) + de->area.x,
+			EobjGetY(eo) + EobjGetBW(eo) + de->area.y,
+			de->area.width, de->area.height);
+	XDamageSubtract(disp, cw->damage, NoXID, NoXID);
      }
    eo->serial = ev->xany.serial;
+#if USE_GLX
+   cw->gl_dirty = 1;
+#endif
    ECompMgrDamageMergeObject(eo, parts);
 
    if (eo->type == EOBJ_TYPE_EWIN)
@@ -1516,7 +2230,7 @@ ECompMgrWinDamage(EObj * eo, XEvent * ev)
 }
 
 static void
-ECompMgrWinDumpInfo(const char *txt, EObj * eo, EX_SrvRegion rgn, int ipc)
+ECompMgrWinDumpInfo(const char *txt, EObj * eo, EX_Region rgn, int ipc)
 {
    void                (*prf) (const char *fmt, ...);
    ECmWinInfo         *cw = eo->cmhook;
@@ -1535,11 +2249,11 @@ ECompMgrWinDumpInfo(const char *txt, EObj * eo, EX_SrvRegion rgn, int ipc)
      {
 	prf(" - pict=%#x pmap=%#x\n", cw->picture, cw->pixmap);
 
-	ERegionShow("win extents", cw->extents, prf);
-	ERegionShow("win shape  ", cw->shape, prf);
-	ERegionShow("win clip   ", cw->clip, prf);
-	if (rgn != NoXID)
-	   ERegionShow("region", rgn, prf);
+	ECRegionShow("win extents", cw->extents, prf);
+	ECRegionShow("win shape  ", cw->shape, prf);
+	ECRegionShow("win clip   ", cw->clip, prf);
+	if (rgn)
+	   ECRegionShow("region", rgn, prf);
      }
 }
 
@@ -1558,12 +2272,83 @@ ECompMgrDestroyClip(void)
 	if (!cw)
 	   continue;
 	cw->have_clip = 0;
+	cw->occluded = 0;
+     }
+}
+
+static void
+ECompMgrCoverReset(void)
+{
+   cover.num = 0;
+   cover.full = 0;
+   cover.n_occluded = 0;
+}
+
+static void
+ECompMgrCoverAdd(int x, int y, int w, int h)
+{
+   XRectangle         *r;
+
+   if (w <= 0 || h <= 0)
+      return;
+
+   if (cover.num >= cover.nalloc)
+     {
+	cover.nalloc += 16;
+	cover.rects = EREALLOC(XRectangle, cover.rects, cover.nalloc);
      }
+   r = cover.rects + cover.num++;
+   r->x = x;
+   r->y = y;
+   r->width = w;
+   r->height = h;
+}
+
+/* Is x,y,w,h covered by cover.rects[ix...]? */
+static int
+_ECompMgrCoverCheck(int x, int y, int w, int h, int ix, int *budget)
+{
+   const XRectangle   *r;
+   int                 y0, y1;
+
+   if (w <= 0 || h <= 0)
+      return 1;
+
+   for (; ix < cover.num; ix++)
+     {
+	r = cover.rects + ix;
+	if (r->x >= x + w || r->x + r->width <= x ||
+	    r->y >= y + h || r->y + r->height <= y)
+	   continue;
+
+	/* Overlap - check the parts outside r against the rest */
+	if (--*budget < 0)
+	   return 0;
+	ix++;
+	y0 = (r->y > y) ? r->y : y;
+	y1 = (r->y + r->height < y + h) ? r->y + r->height : y + h;
+	return
+	   _ECompMgrCoverCheck(x, y, w, y0 - y, ix, budget) &&
+	   _ECompMgrCoverCheck(x, y1, w, y + h - y1, ix, budget) &&
+	   _ECompMgrCoverCheck(x, y0, r->x - x, y1 - y0, ix, budget) &&
+	   _ECompMgrCoverCheck(r->x + r->width, y0, x + w - r->x - r->width,
+			       y1 - y0, ix, budget);
+     }
+
+   return 0;
+}
+
+static int
+ECompMgrCoverCheck(int x, int y, int w, int h)
+{
+   int                 budget = COVER_BUDGET;
+
+   return _ECompMgrCoverCheck(x, y, w, h, 0, &budget);
 }
 
 static int
 ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
-		       EObj ** last, Desk * dsk, EX_SrvRegion clip)
+		       EObj ** last, Desk * dsk, EX_Region clip)
 {
    EObj               *eo, *eo_prev, *eo_first;
    int                 i, stop;
@@ -1572,11 +2357,12 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
    D1printf("%s: %d\n", __func__, dsk->num);
    if (!lst)
       lst = EobjListStackGet(&num);
-   if (clip == NoXID)
+   if (!clip)
      {
 	ECompMgrDestroyClip();
-	clip = Mode_compmgr.rgn_clip;
-	ERegionEmpty(clip);
+	clip = Mode_compmgr.crgn_clip;
+	ECRegionEmpty(clip);
+	ECompMgrCoverReset();
      }
 
    /* Determine overall paint order, top to bottom */
@@ -1599,6 +2385,13 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
 	if (EobjHasEmptyShape(eo))
 	   continue;
 
+	if (cover.full)
+	  {
+	     /* Screen is covered - nothing more to do */
+	     cw->occluded = 1;
+	     continue;
+	  }
+
 	/* Region of shaped window in screen coordinates */
 	if (!cw->have_shape)
 	   ECompMgrWinSetShape(eo);
@@ -1607,6 +2400,16 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
 	if (!cw->have_extents)
 	   ECompMgrWinSetExtents(eo);
 
+	cw->occluded = ECompMgrCoverCheck(EoGetX(dsk) + cw->ebox.x,
+					  EoGetY(dsk) + cw->ebox.y,
+					  cw->ebox.width, cw->ebox.height);
+	if (cw->occluded)
+	  {
+	     D3printf(" - %#x occluded\n", EobjGetXwin(eo));
+	     cover.n_occluded++;
+	     continue;
+	  }
+
 	D3printf(" - %#x desk=%d shown=%d fading=%d fadeout=%d\n",
 		 EobjGetXwin(eo), eo->desk->num, eo->shown, eo->fading,
 		 cw->fadeout);
@@ -1620,11 +2423,11 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
 		continue;
 
 #if USE_CLIP_RELATIVE_TO_DESK
-	     ERegionTranslate(clip, -EoGetX(d), -EoGetY(d));
+	     ECRegionTranslate(clip, -EoGetX(d), -EoGetY(d));
 #endif
 	     stop = ECompMgrDetermineOrder(lst, num, &eo1, &eo2, d, clip);
 #if USE_CLIP_RELATIVE_TO_DESK
-	     ERegionTranslate(clip, EoGetX(d), EoGetY(d));
+	     ECRegionTranslate(clip, EoGetX(d), EoGetY(d));
 #endif
 	     if (eo1)
 	       {
@@ -1643,11 +2446,16 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
 	     if (stop)
 		break;
 #endif
+	     if (cover.full)
+	       {
+		  cw->occluded = 1;
+		  continue;
+	       }
 	  }
 
-	if (cw->clip == NoXID)
-	   cw->clip = ERegionCreate();
-	ERegionCopy(cw->clip, clip);
+	if (!cw->clip)
+	   cw->clip = ECRegionCreate();
+	ECRegionCopy(cw->clip, clip);
 	cw->have_clip = 1;
 
 	ECompMgrWinSetPicts(eo);
@@ -1683,19 +2491,27 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
 	  {
 	  case WINDOW_UNREDIR:
 	  case WINDOW_SOLID:
-	     D3printf("-   clip %#x %#x %d,%d %dx%d: %s\n", EobjGetXwin(eo),
+	     D3printf("-   clip %#x %p %d,%d %dx%d: %s\n", EobjGetXwin(eo),
 		      cw->clip, EobjGetX(eo), EobjGetY(eo), EobjGetW(eo),
 		      EobjGetH(eo), EobjGetName(eo));
 #if USE_CLIP_RELATIVE_TO_DESK
-	     ERegionUnion(clip, cw->shape);
+	     ECRegionUnion(clip, cw->shape);
 #else
-	     ERegionUnionOffset(clip, EoGetX(dsk), EoGetY(dsk), cw->shape,
-				Mode_compmgr.rgn_tmp);
+	     ECRegionTranslate(clip, -EoGetX(dsk), -EoGetY(dsk));
+	     ECRegionUnion(clip, cw->shape);
+	     ECRegionTranslate(clip, EoGetX(dsk), EoGetY(dsk));
 #endif
+	     if (WinIsShaped(EobjGetWin(eo)))
+		break;
+	     ECompMgrCoverAdd(EoGetX(dsk) + EobjGetX(eo) + EobjGetBW(eo),
+			      EoGetY(dsk) + EobjGetY(eo) + EobjGetBW(eo),
+			      EobjGetW(eo), EobjGetH(eo));
+	     if (ECompMgrCoverCheck(0, 0, WinGetW(VROOT), WinGetH(VROOT)))
+		cover.full = 1;
 	     break;
 
 	  default:
-	     D3printf("- noclip %#x %#x %d,%d %dx%d: %s\n", EobjGetXwin(eo),
+	     D3printf("- noclip %#x %p %d,%d %dx%d: %s\n", EobjGetXwin(eo),
 		      cw->clip, EobjGetX(eo), EobjGetY(eo), EobjGetW(eo),
 		      EobjGetH(eo), EobjGetName(eo));
 	     break;
@@ -1716,36 +2532,42 @@ ECompMgrDetermineOrder(EObj * const *lst, int num, EObj ** first,
    *first = eo_first;
    *last = eo_prev;
 
+   D1printf("%s: %d: occluded=%d covered=%d\n", __func__, dsk->num,
+	    cover.n_occluded, cover.full);
+
    Mode_compmgr.reorder = 0;
    return stop;
 }
 
-static              EX_SrvRegion
-ECompMgrRepaintObjSetClip(EX_SrvRegion rgn, EX_SrvRegion damage,
-			  EX_SrvRegion clip, int x, int y)
+static              EX_Region
+ECompMgrRepaintObjSetClip(EX_Region rgn, EX_Region damage,
+			  EX_Region clip, int x, int y)
 {
-   ERegionCopy(rgn, damage);
+   ECRegionCopy(rgn, damage);
 #if USE_CLIP_RELATIVE_TO_DESK
-   ERegionSubtractOffset(rgn, x, y, clip, Mode_compmgr.rgn_tmp);
+   ECRegionTranslate(rgn, -x, -y);
+   ECRegionSubtract(rgn, clip);
+   ECRegionTranslate(rgn, x, y);
 #else
-   ERegionSubtract(rgn, clip);
+   ECRegionSubtract(rgn, clip);
    x = y = 0;
 #endif
    return rgn;
 }
 
-static              EX_SrvRegion
-ECompMgrRepaintObjSetClip2(EObj * eo, EX_SrvRegion clip, int x, int y)
+static              EX_Region
+ECompMgrRepaintObjSetClip2(EObj * eo, EX_Region clip, int x, int y)
 {
 #if 1
    /* This is only needed when source clipping in XRenderComposite() is broken.
     * otherwise it should be possible to set the source clip mask in
     * ECompMgrWinSetPicts() (when needed, i.e. source pict is pixmap). */
-   if (WinIsShaped(EobjGetWin(eo)))
+   if (WinIsShaped(EobjGetWin(eo)) && eo->cmhook->shape)
      {
-	clip = ERegionCopy(Mode_compmgr.rgn_tmp, clip);
-	ERegionIntersectOffset(clip, x, y, eo->cmhook->shape,
-			       Mode_compmgr.rgn_tmp2);
+	clip = ECRegionCopy(Mode_compmgr.crgn_tmp, clip);
+	ECRegionTranslate(clip, -x, -y);
+	ECRegionIntersect(clip, eo->cmhook->shape);
+	ECRegionTranslate(clip, x, y);
      }
 #else
    eo = NULL;
@@ -1755,19 +2577,20 @@ ECompMgrRepaintObjSetClip2(EObj * eo, EX_SrvRegion clip, int x, int y)
 }
 
 static void
-ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
+ECompMgrRepaintObj(EX_Picture pbuf, EX_Region region, EObj * eo, int mode)
 {
-   static EX_SrvRegion rgn_clip = NoXID;
+   static EX_Region    rgn_clip = NULL;
    ECmWinInfo         *cw;
    Desk               *dsk = eo->desk;
    int                 x, y;
-   EX_SrvRegion        clip, clip2;
+   EX_Region           clip, clip2;
    EX_Picture          alpha;
+   unsigned int        t0;
 
    cw = eo->cmhook;
 
-   if (rgn_clip == NoXID)
-      rgn_clip = ERegionCreate();
+   if (!rgn_clip)
+      rgn_clip = ECRegionCreate();
 
    x = EoGetX(dsk);
    y = EoGetY(dsk);
@@ -1791,7 +2614,15 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 	     clip2 = ECompMgrRepaintObjSetClip2(eo, clip, x, y);
 	     if (EDebug(EDBUG_TYPE_COMPMGR2))
 		ECompMgrWinDumpInfo("ECompMgrRepaintObj solid", eo, clip, 0);
-	     EPictureSetClip(pbuf, clip2);
+	     if (ECRegionIsEmpty(clip2))
+	       {
+		  if (stats_on)
+		     stats.clipped++;
+		  break;
+	       }
+	     if (stats_on)
+		stats.painted++;
+	     EPictureSetClipRegion(pbuf, clip2);
 	     XRenderComposite(disp, PictOpSrc, cw->picture, NoXID, pbuf,
 			      0, 0, 0, 0, x + cw->rcx, y + cw->rcy, cw->rcw,
 			      cw->rch);
@@ -1805,7 +2636,7 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 	switch (cw->mode)
 	  {
 	  default:
-	     clip = NoXID;
+	     clip = NULL;
 	     break;
 
 	  case WINDOW_TRANS:
@@ -1814,12 +2645,23 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 	     clip2 = ECompMgrRepaintObjSetClip2(eo, clip, x, y);
 	     if (EDebug(EDBUG_TYPE_COMPMGR2))
 		ECompMgrWinDumpInfo("ECompMgrRepaintObj trans", eo, clip, 0);
-	     EPictureSetClip(pbuf, clip2);
+	     if (ECRegionIsEmpty(clip2))
+	       {
+		  if (stats_on)
+		     stats.clipped++;
+		  break;
+	       }
+	     if (stats_on)
+		stats.painted++;
+	     EPictureSetClipRegion(pbuf, clip2);
 	     if (cw->opacity != OPAQUE && !cw->pict_alpha)
-		cw->pict_alpha =
-		   EPictureCreateSolid(Mode_compmgr.root, True,
-				       OP32To8(cw->opacity),
-				       Conf_compmgr.shadows.color);
+	       {
+		  cw->pict_alpha =
+		     EPictureCreateSolid(Mode_compmgr.root, True,
+					 OP32To8(cw->opacity),
+					 Conf_compmgr.shadows.color);
+		  rebuilds.alpha++;
+	       }
 	     XRenderComposite(disp, PictOpOver, cw->picture, cw->pict_alpha,
 			      pbuf, 0, 0, 0, 0, x + cw->rcx, y + cw->rcy,
 			      cw->rcw, cw->rch);
@@ -1830,21 +2672,32 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 	if (!cw->has_shadow)
 	   return;
 
-	if (clip == NoXID)
+	t0 = (stats_on) ? GetTimeUs() : 0;
+	if (!clip)
 	   clip = ECompMgrRepaintObjSetClip(rgn_clip, region, cw->clip, x, y);
-	ERegionSubtractOffset(clip, x, y, cw->shape, Mode_compmgr.rgn_tmp);
-	EPictureSetClip(pbuf, clip);
+	if (cw->shape)
+	  {
+	     ECRegionTranslate(clip, -x, -y);
+	     ECRegionSubtract(clip, cw->shape);
+	     ECRegionTranslate(clip, x, y);
+	  }
+	if (ECRegionIsEmpty(clip))
+	   return;
+	EPictureSetClipRegion(pbuf, clip);
 
 	switch (Mode_compmgr.shadow_mode)
 	  {
 	  case ECM_SHADOWS_SHARP:
 	  case ECM_SHADOWS_ECHO:
 	     if (cw->opacity != OPAQUE && !cw->shadow_alpha)
-		cw->shadow_alpha =
-		   EPictureCreateSolid(Mode_compmgr.root, True,
-				       OP32To8(cw->opacity *
-					       Mode_compmgr.opac_sharp),
-				       Conf_compmgr.shadows.color);
+	       {
+		  cw->shadow_alpha =
+		     EPictureCreateSolid(Mode_compmgr.root, True,
+					 OP32To8(cw->opacity *
+						 Mode_compmgr.opac_sharp),
+					 Conf_compmgr.shadows.color);
+		  rebuilds.alpha++;
+	       }
 	     alpha = cw->shadow_alpha ? cw->shadow_alpha : transBlackPicture;
 	     if (Mode_compmgr.shadow_mode == ECM_SHADOWS_SHARP)
 		XRenderComposite(disp, PictOpOver, alpha, cw->picture, pbuf,
@@ -1862,13 +2715,24 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 
 	  case ECM_SHADOWS_BLURRED:
 	     if (cw->shadow_pict == NoXID)
-		break;
+	       {
+		  int                 sw, sh;
+
+		  cw->shadow_pict = shadow_picture(Mode_compmgr.opac_blur,
+						   cw->rcw, cw->rch, &sw, &sh);
+		  rebuilds.shadow++;
+		  if (cw->shadow_pict == NoXID)
+		     break;
+	       }
 
 	     if (cw->opacity != OPAQUE && !cw->pict_alpha)
-		cw->pict_alpha =
-		   EPictureCreateSolid(Mode_compmgr.root, True,
-				       OP32To8(cw->opacity),
-				       Conf_compmgr.shadows.color);
+	       {
+		  cw->pict_alpha =
+		     EPictureCreateSolid(Mode_compmgr.root, True,
+					 OP32To8(cw->opacity),
+					 Conf_compmgr.shadows.color);
+		  rebuilds.alpha++;
+	       }
 	     alpha = (cw->pict_alpha) ? cw->pict_alpha : transBlackPicture;
 	     XRenderComposite(disp, PictOpOver, alpha, cw->shadow_pict, pbuf,
 			      0, 0, 0, 0,
@@ -1877,12 +2741,14 @@ ECompMgrRepaintObj(EX_Picture pbuf, EX_SrvRegion region, EObj * eo, int mode)
 			      cw->shadow_width, cw->shadow_height);
 	     break;
 	  }
+	if (stats_on)
+	   stats.t_shadow += GetTimeUs() - t0;
 #endif
      }
 }
 
 static void
-ECompMgrPaintGhosts(EX_Picture pict, EX_SrvRegion damage)
+ECompMgrPaintGhosts(EX_Picture pict, EX_Region damage)
 {
    EObj               *eo, *const *lst;
    int                 i, num;
@@ -1898,17 +2764,476 @@ ECompMgrPaintGhosts(EX_Picture pict, EX_SrvRegion damage)
 	  {
 	  case WINDOW_UNREDIR:
 	  case WINDOW_SOLID:
-	     ECompMgrRepaintObj(pict, Mode_compmgr.rgn_screen, eo, 0);
+	     ECompMgrRepaintObj(pict, Mode_compmgr.crgn_screen, eo, 0);
 	     break;
 	  case WINDOW_TRANS:
 	  case WINDOW_ARGB:
-	     ECompMgrRepaintObj(pict, Mode_compmgr.rgn_screen, eo, 1);
+	     ECompMgrRepaintObj(pict, Mode_compmgr.crgn_screen, eo, 1);
 	     break;
 	  }
 
 	/* Subtract window region from damage region */
-	ERegionSubtract(damage, eo->cmhook->shape);
+	if (!eo->cmhook->shape)
+	   continue;
+	ECRegionSubtract(damage, eo->cmhook->shape);
+     }
+}
+
+static void
+ECompMgrShowPresented(EX_Region damage)
+{
+   static unsigned int n_frames = 0;
+   unsigned int        area, bpp, full;
+   int                 nr;
+
+   n_frames++;
+   area = ECRegionGetArea(damage, &nr);
+   full = WinGetW(VROOT) * WinGetH(VROOT);
+   bpp = (WinGetDepth(VROOT) > 16) ? 4 : (WinGetDepth(VROOT) > 8) ? 2 : 1;
+   Eprintf("%s: frame %u: %d rects, %u bytes (%u%% of %u)\n", __func__,
+	   n_frames, nr, area * bpp, full ? 100 * area / full : 0, full * bpp);
+}
+
+#if USE_GLX
+/*
+ * GL painting
+ *
+ * Everything in the paint list is drawn bottom up in a single pass,
+ * scissored to the damage bounding box. Objects above simply paint over
+ * what is below so no per-object clipping is needed.
+ */
+
+static int
+ECompMgrGlInit(void)
+{
+   if (Mode_compmgr.root == WinGetXwin(VROOT))
+     {
+	Eprintf("%s: GL compositing requires the composite overlay window\n",
+		__func__);
+	return -1;
      }
+
+   if (EGlCmInit(Mode_compmgr.root, WinGetVisual(VROOT)))
+      return -1;
+
+   Mode_compmgr.gl = 1;
+   Mode_compmgr.gl_xrender = 0;
+   return 0;
+}
+
+static void
+ECompMgrGlExit(void)
+{
+   EObj               *const *lst;
+   int                 i, num;
+
+   if (!Mode_compmgr.gl)
+      return;
+
+   lst = EobjListStackGet(&num);
+   for (i = 0; i < num; i++)
+     {
+	if (!lst[i]->cmhook)
+	   continue;
+	TEXTURE_DESTROY(lst[i]->cmhook->gl_tex);
+	TEXTURE_DESTROY(lst[i]->cmhook->gl_shadow);
+     }
+
+   EGlCmExit();
+   Mode_compmgr.gl = 0;
+}
+
+/* Draw texture with source origin at dx,dy excluding the rectangle ex */
+static void
+ECompMgrGlDrawExcl(ETexture * et, int mode, int sx, int sy,
+		   int dx, int dy, int dw, int dh, const XRectangle * ex,
+		   float r, float g, float b, float a)
+{
+   int                 x2, y2, ex1, ey1, ex2, ey2;
+
+#define DRAW(_x, _y, _w, _h) \
+   EGlCmDraw(et, mode, sx + (_x) - dx, sy + (_y) - dy, _w, _h, \
+	     _x, _y, _w, _h, r, g, b, a)
+
+   x2 = dx + dw;
+   y2 = dy + dh;
+   ex1 = MAX(ex->x, dx);
+   ey1 = MAX(ex->y, dy);
+   ex2 = MIN(ex->x + ex->width, x2);
+   ey2 = MIN(ex->y + ex->height, y2);
+   if (ex1 >= ex2 || ey1 >= ey2)
+     {
+	DRAW(dx, dy, dw, dh);
+	return;
+     }
+
+   if (ey1 > dy)
+      DRAW(dx, dy, dw, ey1 - dy);
+   if (y2 > ey2)
+      DRAW(dx, ey2, dw, y2 - ey2);
+   if (ex1 > dx)
+      DRAW(dx, ey1, ex1 - dx, ey2 - ey1);
+   if (x2 > ex2)
+      DRAW(ex2, ey1, x2 - ex2, ey2 - ey1);
+#undef DRAW
+}
+
+static void
+ECompMgrRepaintDeskGl(EObj * eo, Desk * d, int x, int y)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+   int                 pw, ph;
+
+   if (d->bg.pmap == NoXID)
+     {
+	EGlCmFill(x + cw->rcx, y + cw->rcy, cw->rcw, cw->rch,
+		  _R(d->bg.pixel) / 255.f, _G(d->bg.pixel) / 255.f,
+		  _B(d->bg.pixel) / 255.f);
+	return;
+     }
+
+   if (!cw->gl_tex)
+     {
+	if (!EXGetGeometry(d->bg.pmap, NULL, NULL, NULL, &pw, &ph,
+			   NULL, NULL))
+	   return;
+	cw->gl_tex = EGlCmTextureFromPixmap(d->bg.pmap, WinGetDepth(VROOT),
+					    pw, ph, 1);
+     }
+
+   EGlCmDraw(cw->gl_tex, EGL_CM_MODULATE, 0, 0, cw->rcw, cw->rch,
+	     x + cw->rcx, y + cw->rcy, cw->rcw, cw->rch, 1.f, 1.f, 1.f, 1.f);
+}
+
+#if ENABLE_SHADOWS
+static void
+ECompMgrRepaintShadowGl(EObj * eo, int x, int y, int sx, int sy)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+   unsigned int        color = Conf_compmgr.shadows.color;
+   XRectangle          wr;
+   XImage             *xim;
+   float               a;
+
+   /* The shadow is not painted under the window */
+   wr.x = x + cw->rcx;
+   wr.y = y + cw->rcy;
+   wr.width = cw->rcw;
+   wr.height = cw->rch;
+
+   a = OP32To8(cw->opacity) / 255.f;
+
+   switch (Mode_compmgr.shadow_mode)
+     {
+     case ECM_SHADOWS_SHARP:
+	a *= Mode_compmgr.opac_sharp;
+	ECompMgrGlDrawExcl(cw->gl_tex, EGL_CM_SHADOW, sx, sy,
+			   wr.x + cw->shadow_dx, wr.y + cw->shadow_dy,
+			   cw->shadow_width, cw->shadow_height, &wr,
+			   a * _R(color) / 255.f, a * _G(color) / 255.f,
+			   a * _B(color) / 255.f, a);
+	break;
+
+     case ECM_SHADOWS_ECHO:
+	a *= Mode_compmgr.opac_sharp;
+	ECompMgrGlDrawExcl(cw->gl_tex, EGL_CM_MODULATE, sx, sy,
+			   wr.x + cw->shadow_dx, wr.y + cw->shadow_dy,
+			   cw->shadow_width, cw->shadow_height, &wr,
+			   a, a, a, a);
+	break;
+
+     case ECM_SHADOWS_BLURRED:
+	if (!cw->gl_shadow)
+	  {
+	     if (!gaussianMap)
+		break;
+	     xim = make_shadow(sum_gaussian, Mode_compmgr.opac_blur,
+			       cw->rcw, cw->rch);
+	     if (!xim)
+		break;
+	     cw->gl_shadow =
+		EGlCmTextureFromAlpha((unsigned char *)xim->data,
+				      xim->bytes_per_line, xim->width,
+				      xim->height);
+	     XDestroyImage(xim);
+	     if (!cw->gl_shadow)
+		break;
+	  }
+	ECompMgrGlDrawExcl(cw->gl_shadow, EGL_CM_SHADOW, 0, 0,
+			   wr.x + cw->shadow_dx, wr.y + cw->shadow_dy,
+			   cw->gl_shadow->w, cw->gl_shadow->h, &wr,
+			   a * _R(color) / 255.f, a * _G(color) / 255.f,
+			   a * _B(color) / 255.f, a);
+	break;
+     }
+}
+#endif
+
+static void
+ECompMgrRepaintObjGl(EObj * eo, const XRectangle * box)
+{
+   ECmWinInfo         *cw = eo->cmhook;
+   Desk               *dsk = eo->desk;
+   Desk               *d;
+   EX_Pixmap           pmap;
+   XRectangle         *pr;
+   int                 x, y, sx, sy, i, nr;
+   float               a;
+
+   x = EoGetX(dsk);
+   y = EoGetY(dsk);
+
+   /* Skip objects entirely outside the repainted area */
+   if (x + cw->ebox.x >= box->x + box->width ||
+       y + cw->ebox.y >= box->y + box->height ||
+       x + cw->ebox.x + cw->ebox.width <= box->x ||
+       y + cw->ebox.y + cw->ebox.height <= box->y)
+     {
+	if (stats_on)
+	   stats.clipped++;
+	return;
+     }
+   if (stats_on)
+      stats.painted++;
+
+   d = (eo->type == EOBJ_TYPE_DESK) ? (Desk *) eo : dsk;
+   if (d->bg.o == eo)
+     {
+	ECompMgrRepaintDeskGl(eo, d, x, y);
+	return;
+     }
+
+   /* Unredirected objects have no pixmap to texture from */
+   if (eo->noredir)
+      return;
+
+   if (!cw->gl_tex)
+     {
+	pmap = ECompMgrWinGetPixmap(eo);
+	if (pmap == NoXID)
+	   return;
+	cw->gl_tex = EGlCmTextureFromPixmap(pmap, WinGetDepth(EobjGetWin(eo)),
+					    EobjGetW(eo) + 2 * EobjGetBW(eo),
+					    EobjGetH(eo) + 2 * EobjGetBW(eo),
+					    0);
+	if (!cw->gl_tex)
+	   return;
+	cw->gl_dirty = 0;
+     }
+   else if (cw->gl_dirty)
+     {
+	EGlCmTextureRebind(cw->gl_tex);
+	cw->gl_dirty = 0;
+     }
+
+   /* The named pixmap includes the border, the paint rectangle may not */
+   sx = cw->rcx - EobjGetX(eo);
+   sy = cw->rcy - EobjGetY(eo);
+
+#if ENABLE_SHADOWS
+   if (cw->has_shadow)
+     {
+	unsigned int        t0 = (stats_on) ? GetTimeUs() : 0;
+
+	ECompMgrRepaintShadowGl(eo, x, y, sx, sy);
+	if (stats_on)
+	   stats.t_shadow += GetTimeUs() - t0;
+     }
+#endif
+
+   a = OP32To8(cw->opacity) / 255.f;
+
+   if (!WinIsShaped(EobjGetWin(eo)) || !cw->shape)
+     {
+	EGlCmDraw(cw->gl_tex, EGL_CM_MODULATE, sx, sy, cw->rcw, cw->rch,
+		  x + cw->rcx, y + cw->rcy, cw->rcw, cw->rch, a, a, a, a);
+	return;
+     }
+
+   /* Shape is in desk coordinates */
+   pr = ECRegionGetRects(cw->shape, &nr);
+   for (i = 0; i < nr; i++)
+      EGlCmDraw(cw->gl_tex, EGL_CM_MODULATE,
+		pr[i].x - EobjGetX(eo), pr[i].y - EobjGetY(eo),
+		pr[i].width, pr[i].height, x + pr[i].x, y + pr[i].y,
+		pr[i].width, pr[i].height, a, a, a, a);
+   Efree(pr);
+}
+
+static void
+ECompMgrRepaintGl(EX_Region region)
+{
+   EObj               *eo;
+   XRectangle          box;
+
+   /* Without sub-buffer copy the back buffer is undefined after a swap */
+   if (EGlCmPartialUpdates())
+     {
+	ECRegionGetBox(region, &box);
+     }
+   else
+     {
+	box.x = box.y = 0;
+	box.width = WinGetW(VROOT);
+	box.height = WinGetH(VROOT);
+     }
+   if (box.width == 0 || box.height == 0)
+      return;
+
+   EGlCmFrameBegin(WinGetW(VROOT), WinGetH(VROOT), &box);
+
+   for (eo = Mode_compmgr.eo_last; eo; eo = eo->cmhook->prev)
+      ECompMgrRepaintObjGl(eo, &box);
+
+   /* Ghosts are not in the paint list, they go on top (bottom up) */
+   if (Mode_compmgr.ghosts)
+     {
+	EObj               *const *lst;
+	int                 i, num;
+
+	lst = EobjListStackGet(&num);
+	for (i = num - 1; i >= 0; i--)
+	  {
+	     eo = lst[i];
+	     if (eo->shown && eo->ghost && eo->cmhook)
+		ECompMgrRepaintObjGl(eo, &box);
+	  }
+     }
+
+   EGlCmFrameEnd(&box);
+}
+
+/*
+ * Objects unredirected by configuration have no pixmap to texture from.
+ * Paint with XRender while any are in the paint list, and repaint the
+ * whole screen when switching between GL and XRender.
+ */
+static int
+ECompMgrGlUsable(void)
+{
+   EObj               *eo;
+   char                xrender;
+
+   xrender = 0;
+   for (eo = Mode_compmgr.eo_first; eo; eo = eo->cmhook->next)
+     {
+	if (eo->noredir && eo != Mode_compmgr.unredir.eo)
+	  {
+	     xrender = 1;
+	     break;
+	  }
+     }
+
+   if (xrender != Mode_compmgr.gl_xrender)
+     {
+	D1printf("%s: painting with %s\n", __func__, xrender ? "XRender" : "GL");
+	Mode_compmgr.gl_xrender = xrender;
+	ECRegionCopy(Mode_compmgr.crgn_paint, Mode_compmgr.crgn_screen);
+	ECompMgrUnredirSubtract(Mode_compmgr.crgn_paint);
+     }
+
+   return !xrender;
+}
+#endif /* USE_GLX */
+
+static void
+ECompMgrStatsReset(void)
+{
+   memset(&stats, 0, sizeof(stats));
+   stats.t_start = GetTimeMs();
+}
+
+static void
+ECompMgrStatsFrame(unsigned int t0)
+{
+   unsigned int        t1, dt;
+   int                 bin;
+
+   if (!stats_on)
+      return;
+
+   t1 = GetTimeUs();
+   dt = t1 - t0;
+
+   stats.frames++;
+   stats.t_frame += dt;
+   if (stats.t_frame_max < dt)
+      stats.t_frame_max = dt;
+   for (bin = 0, dt /= 1000; dt && bin < ECM_STATS_NBINS - 1; dt >>= 1)
+      bin++;
+   stats.hist[bin]++;
+
+   if (stats.frames % ECM_STATS_SYNC_EVERY)
+      return;
+
+   /* Sample the time the server needs to finish the frame */
+   ESync(0);
+   dt = GetTimeUs() - t1;
+   stats.n_sync++;
+   stats.t_sync += dt;
+   if (stats.t_sync_max < dt)
+      stats.t_sync_max = dt;
+}
+
+static void
+ECompMgrStatsShow(void)
+{
+   static const char  *const bins[ECM_STATS_NBINS] = {
+      "<1", "<2", "<4", "<8", "<16", "<32", "<64", ">=64"
+   };
+   unsigned int        dt, nf, full;
+   int                 i;
+
+   if (!stats_on)
+     {
+	IpcPrintf("Paint statistics are off, enable with \"cm stats on\"\n");
+	return;
+     }
+
+   dt = GetTimeMs() - stats.t_start;
+   nf = stats.frames ? stats.frames : 1;
+   full = WinGetW(VROOT) * WinGetH(VROOT);
+
+   IpcPrintf("Frames:     %u in %.1f s (%.1f/s)\n", stats.frames,
+	     1e-3 * dt, dt ? 1e3 * stats.frames / dt : 0.);
+   IpcPrintf("Frame time: avg %.3f ms  max %.3f ms\n",
+	     1e-3 * stats.t_frame / nf, 1e-3 * stats.t_frame_max);
+   IpcPrintf("Histogram: ");
+   for (i = 0; i < ECM_STATS_NBINS; i++)
+      IpcPrintf(" %sms:%u", bins[i], stats.hist[i]);
+   IpcPrintf("\n");
+   IpcPrintf("Ordering:   %u reorders, %.3f ms total, %u objects occluded\n",
+	     stats.reorders, 1e-3 * stats.t_order, stats.occluded);
+   IpcPrintf("Objects:    painted %.1f  clipped %.1f per frame\n",
+	     (double)stats.painted / nf, (double)stats.clipped / nf);
+   IpcPrintf("Damage:     %.0f pixels per frame (%.1f%% of screen)\n",
+	     (double)stats.area / nf,
+	     full ? 100. * stats.area / nf / full : 0.);
+   IpcPrintf("Shadows:    %.3f ms per frame\n", 1e-3 * stats.t_shadow / nf);
+   IpcPrintf("Fading:     %u steps, %.3f ms per step\n", stats.fade_steps,
+	     stats.fade_steps ? 1e-3 * stats.t_fade / stats.fade_steps : 0.);
+   IpcPrintf("Server:     avg %.3f ms  max %.3f ms (%u samples)\n",
+	     stats.n_sync ? 1e-3 * stats.t_sync / stats.n_sync : 0.,
+	     1e-3 * stats.t_sync_max, stats.n_sync);
+}
+
+static void
+ECompMgrShowRebuilds(void)
+{
+   unsigned int        tnow, dt;
+
+   tnow = GetTimeMs();
+   dt = tnow - rebuilds.t_last;
+   if (dt < 1000)
+      return;
+
+   Eprintf("%s: per second: pixmap %.1f picture %.1f shadow %.1f"
+	   " shape %.1f alpha %.1f - parked %d\n", __func__,
+	   1e3 * rebuilds.pixmap / dt, 1e3 * rebuilds.picture / dt,
+	   1e3 * rebuilds.shadow / dt, 1e3 * rebuilds.shape / dt,
+	   1e3 * rebuilds.alpha / dt, parked.num);
+   memset(&rebuilds, 0, sizeof(rebuilds));
+   rebuilds.t_last = tnow;
 }
 
 void
@@ -1917,16 +3242,28 @@ ECompMgrRepaint(void)
    EObj               *eo;
    EX_Picture          pbuf;
    Desk               *dsk = DeskGet(0);
+#if USE_XPRESENT
+   unsigned int        t0 = GetTimeMs();
+#endif
+#if USE_GLX
+   int                 paint_gl;
+#endif
+   unsigned int        t1, t2;
 
    if (!Mode_compmgr.active || !Mode_compmgr.got_damage)
       return;
 
-   ERegionIntersect(Mode_compmgr.damage, Mode_compmgr.rgn_screen);
+   t1 = (stats_on) ? GetTimeUs() : 0;
+
+   /* All clip calculations while painting are done client side */
+   ECRegionCopy(Mode_compmgr.crgn_paint, Mode_compmgr.crgn_damage);
+   ECRegionIntersect(Mode_compmgr.crgn_paint, Mode_compmgr.crgn_screen);
+   ECompMgrUnredirSubtract(Mode_compmgr.crgn_paint);
 
    D2printf("%s: rootBuffer=%#x rootPicture=%#x\n", __func__,
 	    rootBuffer, rootPicture);
    if (EDebug(EDBUG_TYPE_COMPMGR2))
-      ERegionShow("damage", Mode_compmgr.damage, NULL);
+      ECRegionShow("damage", Mode_compmgr.crgn_paint, NULL);
 
    pbuf = rootBuffer;
 
@@ -1935,12 +3272,36 @@ ECompMgrRepaint(void)
 
    /* Do paint order list linking */
    if (Mode_compmgr.reorder)
-      ECompMgrDetermineOrder(NULL, 0, &Mode_compmgr.eo_first,
-			     &Mode_compmgr.eo_last, dsk, NoXID);
+     {
+	t2 = (stats_on) ? GetTimeUs() : 0;
+	ECompMgrDetermineOrder(NULL, 0, &Mode_compmgr.eo_first,
+			       &Mode_compmgr.eo_last, dsk, NULL);
+	if (stats_on)
+	  {
+	     stats.t_order += GetTimeUs() - t2;
+	     stats.reorders++;
+	     stats.occluded += cover.n_occluded;
+	  }
+     }
+
+#if USE_GLX
+   paint_gl = Mode_compmgr.gl && ECompMgrGlUsable();
+#endif
+
+   if (stats_on)
+      stats.area += ECRegionGetArea(Mode_compmgr.crgn_paint, NULL);
+
+#if USE_GLX
+   if (paint_gl)
+     {
+	ECompMgrRepaintGl(Mode_compmgr.crgn_paint);
+	goto done;
+     }
+#endif
 
    /* Paint opaque windows top down */
    for (eo = Mode_compmgr.eo_first; eo; eo = eo->cmhook->next)
-      ECompMgrRepaintObj(pbuf, Mode_compmgr.damage, eo, 0);
+      ECompMgrRepaintObj(pbuf, Mode_compmgr.crgn_paint, eo, 0);
 
 #if 0				/* FIXME - NoBg? */
    EX_Picture          pict;
@@ -1958,28 +3319,138 @@ ECompMgrRepaint(void)
 
    /* Paint trans windows and shadows bottom up */
    for (eo = Mode_compmgr.eo_last; eo; eo = eo->cmhook->prev)
-      ECompMgrRepaintObj(pbuf, Mode_compmgr.damage, eo, 1);
+      ECompMgrRepaintObj(pbuf, Mode_compmgr.crgn_paint, eo, 1);
 
    /* Paint any ghost windows (adjusting damage region) */
    if (Mode_compmgr.ghosts)
-      ECompMgrPaintGhosts(rootPicture, Mode_compmgr.damage);
+      ECompMgrPaintGhosts(rootPicture, Mode_compmgr.crgn_paint);
 
    if (pbuf != rootPicture)
      {
+	/* The only upload of the damage per frame */
+	ECRegionUpload(Mode_compmgr.damage, Mode_compmgr.crgn_paint);
 	EPictureSetClip(pbuf, NoXID);
 	EPictureSetClip(rootPicture, Mode_compmgr.damage);
-#if !USE_XPRESENT
-	XRenderComposite(disp, PictOpSrc, pbuf, NoXID, rootPicture,
-			 0, 0, 0, 0, 0, 0, WinGetW(VROOT), WinGetH(VROOT));
-#else
-	XPresentPixmap(disp, Mode_compmgr.root, Mode_compmgr.pmap,
-		       Mode_compmgr.present_serial++, None, None, 0, 0, None,
-		       None, None, None, 0, 0, 0, NULL, 0);
+#if USE_XPRESENT
+	if (Mode_compmgr.present.active)
+	  {
+	     /* The buffer is persistent (single back pixmap, no swapping),
+	      * so only the accumulated damage needs to be transferred. */
+	     XPresentPixmap(disp, Mode_compmgr.root, Mode_compmgr.pmap,
+			    Mode_compmgr.present.serial++, NoXID,
+			    Mode_compmgr.damage, 0, 0, NoXID, NoXID, NoXID,
+			    PresentOptionNone, 0, 0, 0, NULL, 0);
+	     Mode_compmgr.present.pending = 1;
+	     Mode_compmgr.present.t_sent = GetTimeMs();
+	     Mode_compmgr.present.t_render = Mode_compmgr.present.t_sent - t0;
+	  }
+	else
 #endif
+	   XRenderComposite(disp, PictOpSrc, pbuf, NoXID, rootPicture,
+			    0, 0, 0, 0, 0, 0, WinGetW(VROOT), WinGetH(VROOT));
+	if (EDebug(EDBUG_TYPE_COMPMGR))
+	   ECompMgrShowPresented(Mode_compmgr.crgn_paint);
      }
 
+#if USE_GLX
+ done:
+#endif
+   if (EDebug(EDBUG_TYPE_COMPMGR))
+      ECompMgrShowRebuilds();
+
    Mode_compmgr.got_damage = 0;
+
+   ECompMgrUnredirCheck(Mode_compmgr.eo_first);
+
+   ECompMgrStatsFrame(t1);
+}
+
+#if USE_XPRESENT
+static void
+ECompMgrPresentInit(void)
+{
+   Mode_compmgr.present.active = XEXT_AVAILABLE(XEXT_PRESENT);
+   if (!Mode_compmgr.present.active)
+      return;
+
+   Mode_compmgr.present.eid =
+      XPresentSelectInput(disp, Mode_compmgr.root, PresentCompleteNotifyMask);
+   Mode_compmgr.present.pending = 0;
+   Mode_compmgr.present.t_vbl = GetTimeMs();
+   Mode_compmgr.present.period = 1000000 / Mode.screen.fps;
+   Mode_compmgr.present.ust = Mode_compmgr.present.msc = 0;
+}
+
+static void
+ECompMgrPresentExit(void)
+{
+   if (!Mode_compmgr.present.active)
+      return;
+
+   XPresentFreeInput(disp, Mode_compmgr.root, Mode_compmgr.present.eid);
+   Mode_compmgr.present.active = 0;
+}
+
+void
+ECompMgrPresentComplete(EX_Window win, unsigned int serial,
+			unsigned long long ust, unsigned long long msc)
+{
+   unsigned int        period;
+
+   if (!Mode_compmgr.present.active || win != Mode_compmgr.root)
+      return;
+
+   /* Track the actual refresh period from successive completions */
+   if (Mode_compmgr.present.msc > 0 && msc > Mode_compmgr.present.msc &&
+       ust > Mode_compmgr.present.ust)
+     {
+	period = (ust - Mode_compmgr.present.ust) /
+	   (msc - Mode_compmgr.present.msc);
+	if (period >= 4000 && period <= 50000)	/* 20-250 Hz */
+	   Mode_compmgr.present.period =
+	      (3 * Mode_compmgr.present.period + period) / 4;
+     }
+   Mode_compmgr.present.ust = ust;
+   Mode_compmgr.present.msc = msc;
+   Mode_compmgr.present.t_vbl = GetTimeMs();
+
+   if (serial == Mode_compmgr.present.serial - 1)
+      Mode_compmgr.present.pending = 0;
+
+   D2printf("%s: serial=%u msc=%llu period=%u us\n", __func__,
+	    serial, msc, Mode_compmgr.present.period);
+}
+
+/* Time (ms) until the next frame should be rendered, <= 0 means now */
+static int
+ECompMgrPresentNextIn(unsigned int tnow)
+{
+   int                 dt_frame, dt_margin, dt;
+
+   dt_frame = (Mode_compmgr.present.period + 500) / 1000;
+
+   if (Mode_compmgr.present.pending)
+     {
+	/* Coalesce damage until the previous frame is on screen, but
+	 * don't hang if the completion never arrives. */
+	dt = (int)(Mode_compmgr.present.t_sent + 4 * dt_frame - tnow);
+	if (dt > 0)
+	   return dt;
+	D1printf("%s: No completion for serial %u\n", __func__,
+		 Mode_compmgr.present.serial - 1);
+	Mode_compmgr.present.pending = 0;
+	return 0;
+     }
+
+   /* Render just in time for the next vblank */
+   dt_margin = Mode_compmgr.present.t_render + 1;
+   if (dt_margin > dt_frame / 2)
+      dt_margin = dt_frame / 2;
+   dt = (int)(Mode_compmgr.present.t_vbl + dt_frame - dt_margin - tnow);
+
+   return dt;
 }
+#endif /* USE_XPRESENT */
 
 int
 ECompMgrRender(int dt)
@@ -1993,6 +3464,18 @@ ECompMgrRender(int dt)
       return dt;
 
    tnow = GetTimeMs();
+#if USE_XPRESENT
+   if (Mode_compmgr.present.active)
+     {
+	dt_rendr = ECompMgrPresentNextIn(tnow);
+	if (dt_rendr <= 0)
+	  {
+	     ECompMgrRepaint();
+	     return dt;
+	  }
+	return dt == 0 || dt > dt_rendr ? dt_rendr : dt;
+     }
+#endif
    dt_rendr = tnow - ecm_render_last;	/* May be < 0 on startup */
    dt_frame = 1000 / Mode.screen.fps;
    if (dt_rendr >= dt_frame || dt_rendr < 0)
@@ -2017,8 +3500,11 @@ ECompMgrRootBufferCreate(unsigned int w, unsigned int h)
    /* Screen region */
    Mode_compmgr.rgn_screen = ERegionCreateRect(0, 0, w, h);
 
+   Mode_compmgr.crgn_screen = ECRegionCreate();
+   ECRegionSetRect(Mode_compmgr.crgn_screen, 0, 0, w, h);
+
    /* Overall clip region used while recalculating window clip regions */
-   Mode_compmgr.rgn_clip = ERegionCreate();
+   Mode_compmgr.crgn_clip = ECRegionCreate();
 }
 
 static void
@@ -2028,7 +3514,8 @@ ECompMgrRootBufferDestroy(void)
    PIXMAP_DESTROY(Mode_compmgr.pmap);
 
    REGION_DESTROY(Mode_compmgr.rgn_screen);
-   REGION_DESTROY(Mode_compmgr.rgn_clip);
+   CREGION_DESTROY(Mode_compmgr.crgn_screen);
+   CREGION_DESTROY(Mode_compmgr.crgn_clip);
 }
 
 EX_Pixmap
@@ -2073,12 +3560,8 @@ ECompMgrRootExpose(void *prm __UNUSED__, XEvent * ev)
    n_expose++;
    if (ev->xexpose.count == 0)
      {
-	EX_SrvRegion        region;
-
-	region = ERegionCreateFromRects(expose_rects, n_expose);
-
-	ECompMgrDamageMerge(region);
-	ERegionDestroy(region);
+	ECRegionSetRects(Mode_compmgr.crgn_tmp2, expose_rects, n_expose, 0);
+	ECompMgrDamageMerge(Mode_compmgr.crgn_tmp2);
 	n_expose = 0;
      }
 }
@@ -2099,6 +3582,7 @@ ECompMgrShadowsInit(int mode, int cleanup)
 
    Efree(gaussianMap);
    gaussianMap = NULL;
+   shadow_tiles_free();
 
    if (mode != ECM_SHADOWS_OFF)
      {
@@ -2177,13 +3661,29 @@ ECompMgrStart(void)
 #endif
 
    Mode_compmgr.got_damage = 0;
+   ECompMgrStatsReset();
 
    ECompMgrRootBufferCreate(WinGetW(VROOT), WinGetH(VROOT));
 
    rootPicture = EPictureCreateII(VROOT, Mode_compmgr.root);
+#if USE_GLX
+   if (Conf_compmgr.use_gl)
+      ECompMgrGlInit();
+#endif
+#if USE_XPRESENT
+#if USE_GLX
+   if (!Mode_compmgr.gl)
+#endif
+      ECompMgrPresentInit();
+#endif
 
    Mode_compmgr.rgn_tmp = ERegionCreate();
    Mode_compmgr.rgn_tmp2 = ERegionCreate();
+   Mode_compmgr.damage = ERegionCreate();
+   Mode_compmgr.crgn_damage = ECRegionCreate();
+   Mode_compmgr.crgn_paint = ECRegionCreate();
+   Mode_compmgr.crgn_tmp = ECRegionCreate();
+   Mode_compmgr.crgn_tmp2 = ECRegionCreate();
 
    ECompMgrShadowsInit(Conf_compmgr.shadows.mode, 0);
 
@@ -2242,6 +3742,8 @@ ECompMgrStop(void)
       return;
    Conf_compmgr.enable = Mode_compmgr.active = 0;
 
+   TIMER_DEL(Mode_compmgr.unredir.timer);
+
    EGrabServer();
 
    SelectionRelease(wm_cm_sel);
@@ -2271,6 +3773,16 @@ ECompMgrStop(void)
    ECompMgrShadowsInit(ECM_SHADOWS_OFF, 0);
    REGION_DESTROY(Mode_compmgr.rgn_tmp);
    REGION_DESTROY(Mode_compmgr.rgn_tmp2);
+   CREGION_DESTROY(Mode_compmgr.crgn_damage);
+   CREGION_DESTROY(Mode_compmgr.crgn_paint);
+   CREGION_DESTROY(Mode_compmgr.crgn_tmp);
+   CREGION_DESTROY(Mode_compmgr.crgn_tmp2);
+#if USE_XPRESENT
+   ECompMgrPresentExit();
+#endif
+#if USE_GLX
+   ECompMgrGlExit();
+#endif
    PICTURE_DESTROY(rootPicture);
    ECompMgrRootBufferDestroy();
 
@@ -2556,6 +4068,75 @@ ECompMgrSighan(int sig, void *prm __UNUSED__)
      }
 }
 
+#if USE_GLX && ENABLE_BENCHMARKS
+/* Repaint the whole screen nframes times, return average frame time (us) */
+static unsigned int
+ECompMgrRepaintBench(int nframes, unsigned int *ptmin, unsigned int *ptmax)
+{
+   unsigned int        t0, dt, tsum, tmin, tmax;
+   int                 i;
+
+   tsum = tmax = 0;
+   tmin = ~0U;
+   for (i = 0; i < nframes; i++)
+     {
+	ECompMgrDamageAll();
+	t0 = GetTimeUs();
+	ECompMgrRepaint();
+	if (Mode_compmgr.gl)
+	   EGlCmFinish();
+	ESync(0);
+	dt = GetTimeUs() - t0;
+	tsum += dt;
+	if (tmin > dt)
+	   tmin = dt;
+	if (tmax < dt)
+	   tmax = dt;
+     }
+   *ptmin = tmin;
+   *ptmax = tmax;
+
+   return tsum / nframes;
+}
+
+static void
+ECompMgrGlBench(int nframes)
+{
+   unsigned int        tavg, tmin, tmax;
+   char                gl_save;
+
+   if (!Mode_compmgr.active)
+     {
+	IpcPrintf("Compositing is not active\n");
+	return;
+     }
+   if (nframes <= 0)
+      nframes = 100;
+
+   gl_save = Mode_compmgr.gl;
+
+   Mode_compmgr.gl = 0;
+   tavg = ECompMgrRepaintBench(nframes, &tmin, &tmax);
+   IpcPrintf("XRender: %d frames  avg %8.3f ms  min %8.3f ms  max %8.3f ms\n",
+	     nframes, 1e-3 * tavg, 1e-3 * tmin, 1e-3 * tmax);
+
+   Mode_compmgr.gl = gl_save;
+   if (!gl_save && ECompMgrGlInit())
+     {
+	IpcPrintf("GL:      not available\n");
+	ECompMgrDamageAll();
+	return;
+     }
+   tavg = ECompMgrRepaintBench(nframes, &tmin, &tmax);
+   IpcPrintf("GL:      %d frames  avg %8.3f ms  min %8.3f ms  max %8.3f ms\n",
+	     nframes, 1e-3 * tavg, 1e-3 * tmin, 1e-3 * tmax);
+   if (!gl_save)
+      ECompMgrGlExit();
+
+   ECompMgrDamageAll();
+}
+#endif
+
 static void
 CompMgrIpc(const char *params)
 {
@@ -2599,8 +4180,31 @@ CompMgrIpc(const char *params)
 	sscanf(prm, "%x", &win);
 	eo = EobjListStackFind(win);
 	if (eo)
-	   ECompMgrWinDumpInfo("EObj", eo, NoXID, 1);
+	   ECompMgrWinDumpInfo("EObj", eo, NULL, 1);
+     }
+#if ENABLE_SHADOWS && ENABLE_BENCHMARKS
+   else if (!strcmp(cmd, "shadowbench"))
+     {
+	ECompMgrShadowBench();
+     }
+#endif
+   else if (!strcmp(cmd, "stats"))
+     {
+	if (!strcmp(prm, "reset") || !strcmp(prm, "on"))
+	   ECompMgrStatsReset();
+	if (!strcmp(prm, "on"))
+	   stats_on = 1;
+	else if (!strcmp(prm, "off"))
+	   stats_on = 0;
+	else if (!prm[0])
+	   ECompMgrStatsShow();
      }
+#if USE_GLX && ENABLE_BENCHMARKS
+   else if (!strcmp(cmd, "glbench"))
+     {
+	ECompMgrGlBench(atoi(prm));
+     }
+#endif
 }
 
 static const IpcItem CompMgrIpcArray[] = {
@@ -2610,7 +4214,15 @@ static const IpcItem CompMgrIpcArray[] = {
     "Composite manager functions",
     "  cm ?                     Show info\n"
     "  cm start                 Start composite manager\n"
-    "  cm stop                  Stop composite manager\n"}
+    "  cm stop                  Stop composite manager\n"
+    "  cm stats [on|off|reset]  Show/enable/disable/reset paint statistics\n"
+#if ENABLE_SHADOWS && ENABLE_BENCHMARKS
+    "  cm shadowbench           Time shadow generation\n"
+#endif
+#if USE_GLX && ENABLE_BENCHMARKS
+    "  cm glbench [frames]      Compare XRender and GL frame times\n"
+#endif
+    }
    ,
 };
 #define N_IPC_FUNCS (sizeof(CompMgrIpcArray)/sizeof(IpcItem))
@@ -2633,6 +4245,11 @@ static const CfgItem CompMgrCfgItems[] = {
    CFG_ITEM_INT(Conf_compmgr, fading.time, 200),
    CFG_ITEM_INT(Conf_compmgr, override_redirect.mode, 1),
    CFG_ITEM_INT(Conf_compmgr, override_redirect.opacity, 90),
+   CFG_ITEM_BOOL(Conf_compmgr, unredir_fs.enable, 1),
+   CFG_ITEM_INT(Conf_compmgr, unredir_fs.delay, 500),
+#if USE_GLX
+   CFG_ITEM_BOOL(Conf_compmgr, use_gl, 0),
+#endif
 };
 #define N_CFG_ITEMS (sizeof(CompMgrCfgItems)/sizeof(CfgItem))
 
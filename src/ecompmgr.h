@@ -44,6 +44,8 @@ void                ECompMgrDeskConfigure(Desk * dsk);
 
 EX_Pixmap           ECompMgrGetRootBuffer(void);
 
+void                ECompMgrDamageTrack(EX_Region rgn, void (*func)(void));
+
 void                ECompMgrWinNew(EObj * eo);
 void                ECompMgrWinDel(EObj * eo);
 void                ECompMgrWinMap(EObj * eo);
@@ -60,6 +62,7 @@ void                ECompMgrWinChangeOpacity(EObj * eo, unsigned int opacity);
 void                ECompMgrWinChangeShadow(EObj * eo, int shadow);
 EX_Pixmap           ECompMgrWinGetPixmap(const EObj * eo);
 EX_Picture          ECompMgrWinGetAlphaPict(const EObj * eo);
+EX_Picture          ECompMgrWinGetPicture(EObj * eo);
 void                ECompMgrWinClipToGC(EObj * eo, GC gc);
 
 void                ECompMgrConfigGet(cfg_composite * cfg);
@@ -67,6 +70,11 @@ void                ECompMgrConfigSet(const cfg_composite * cfg);
 
 void                ECompMgrRepaint(void);
 int                 ECompMgrRender(int dt);
+#if USE_XPRESENT
+void                ECompMgrPresentComplete(EX_Window win, unsigned int serial,
+					    unsigned long long ust,
+					    unsigned long long msc);
+#endif
 
 #else
 
@@ -479,6 +479,418 @@ EGlTextureInvalidate(ETexture * et)
      }
 }
 
+/*
+ * Compositor support
+ *
+ * Paints into the compositor window (normally the composite overlay
+ * window) using a context matching its visual. Window contents are bound
+ * with texture-from-pixmap, using an fbconfig matching the pixmap depth.
+ */
+
+typedef void        (*glXCopySubBufferMESA_func) (Display * dpy,
+						  GLXDrawable drawable,
+						  int x, int y,
+						  int width, int height);
+
+static struct {
+   GLXContext          ctx;
+   GLXFBConfig         fbc_tex[2];	/* Depth 24, 32 */
+   char                have_tex[2];
+   char                y_inverted[2];
+   EX_Window           xwin;
+   int                 w, h;
+   glXCopySubBufferMESA_func copy_sub_buffer;
+} eglcm;
+
+static int
+_EGlCmConfigsFind(VisualID vid, GLXFBConfig * pfbc)
+{
+   static const int    attrs[] = {
+      GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+      GLX_RENDER_TYPE, GLX_RGBA_BIT,
+      GLX_DOUBLEBUFFER, True,
+      0
+   };
+   static const int    attrs_tex[] = {
+      GLX_DRAWABLE_TYPE, GLX_PIXMAP_BIT,
+      GLX_RENDER_TYPE, GLX_RGBA_BIT,
+      0
+   };
+   GLXFBConfig        *fbc;
+   XVisualInfo        *vi;
+   int                 i, j, num, found, depth, value;
+
+   /* Window config - must match the window visual */
+   found = 0;
+   fbc = glXChooseFBConfig(disp, DefaultScreen(disp), attrs, &num);
+   for (i = 0; i < num && !found; i++)
+     {
+	vi = glXGetVisualFromFBConfig(disp, fbc[i]);
+	if (!vi)
+	   continue;
+	if (vi->visualid == vid)
+	  {
+	     *pfbc = fbc[i];
+	     found = 1;
+	  }
+	XFree(vi);
+     }
+   if (fbc)
+      XFree(fbc);
+   if (!found)
+      return -1;
+
+   /* Texture-from-pixmap configs for depth 24 and 32 pixmaps */
+   fbc = glXChooseFBConfig(disp, DefaultScreen(disp), attrs_tex, &num);
+   for (i = 0; i < num; i++)
+     {
+	vi = glXGetVisualFromFBConfig(disp, fbc[i]);
+	if (!vi)
+	   continue;
+	depth = vi->depth;
+	XFree(vi);
+	j = (depth == 32) ? 1 : (depth == 24) ? 0 : -1;
+	if (j < 0 || eglcm.have_tex[j])
+	   continue;
+
+	value = 0;
+	glXGetFBConfigAttrib(disp, fbc[i], (j == 1) ?
+			     GLX_BIND_TO_TEXTURE_RGBA_EXT :
+			     GLX_BIND_TO_TEXTURE_RGB_EXT, &value);
+	if (!value)
+	   continue;
+
+	/* Pixmaps are bound as (non power of two) GL_TEXTURE_2D */
+	value = 0;
+	glXGetFBConfigAttrib(disp, fbc[i], GLX_BIND_TO_TEXTURE_TARGETS_EXT,
+			     &value);
+	if (!(value & GLX_TEXTURE_2D_BIT_EXT))
+	   continue;
+
+	eglcm.fbc_tex[j] = fbc[i];
+	eglcm.have_tex[j] = 1;
+	value = 0;
+	glXGetFBConfigAttrib(disp, fbc[i], GLX_Y_INVERTED_EXT, &value);
+	eglcm.y_inverted[j] = value != 0;
+	D2printf("%s: depth %d: fbconfig %d y_inverted=%d\n", __func__,
+		 depth, i, value);
+     }
+   if (fbc)
+      XFree(fbc);
+
+   return eglcm.have_tex[0] ? 0 : -1;
+}
+
+static void
+_EGlCmMakeCurrent(void)
+{
+   if (glXGetCurrentContext() != eglcm.ctx)
+      glXMakeContextCurrent(disp, eglcm.xwin, eglcm.xwin, eglcm.ctx);
+}
+
+int
+EGlCmInit(EX_Window xwin, Visual * vis)
+{
+   GLXFBConfig         fbc;
+
+   Dprintf("%s: win=%#x\n", __func__, xwin);
+
+   memset(&eglcm, 0, sizeof(eglcm));
+
+#ifndef HAVE_GLX_glXBindTexImageEXT
+   if (glx_funcs_init())
+     {
+	Eprintf("glXBindTexImageEXT or glXReleaseTexImageEXT not available\n");
+	return -1;
+     }
+#endif
+
+   if (_EGlCmConfigsFind(XVisualIDFromVisual(vis), &fbc))
+     {
+	Eprintf("%s: No suitable FB configs\n", __func__);
+	return -1;
+     }
+
+   eglcm.ctx = glXCreateNewContext(disp, fbc, GLX_RGBA_TYPE, NULL, True);
+   if (!eglcm.ctx)
+     {
+	Eprintf("%s: Failed to create context\n", __func__);
+	return -1;
+     }
+   eglcm.xwin = xwin;
+   _EGlCmMakeCurrent();
+
+   if (!strstr((const char *)glGetString(GL_EXTENSIONS),
+	       "GL_ARB_texture_non_power_of_two"))
+     {
+	Eprintf("%s: GL_ARB_texture_non_power_of_two not available\n",
+		__func__);
+	EGlCmExit();
+	return -1;
+     }
+
+   /* Allows repainting only the damaged part of the back buffer */
+   if (strstr(glXQueryExtensionsString(disp, DefaultScreen(disp)),
+	      "GLX_MESA_copy_sub_buffer"))
+      eglcm.copy_sub_buffer = (glXCopySubBufferMESA_func)
+	 glXGetProcAddress((const GLubyte *)"glXCopySubBufferMESA");
+
+   glDisable(GL_DEPTH_TEST);
+   glEnable(GL_TEXTURE_2D);
+   glEnable(GL_SCISSOR_TEST);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);	/* Premultiplied */
+
+   Dprintf("%s: Renderer: %s, direct=%d copy_sub_buffer=%d\n", __func__,
+	   glGetString(GL_RENDERER), glXIsDirect(disp, eglcm.ctx),
+	   eglcm.copy_sub_buffer != NULL);
+
+   return 0;
+}
+
+void
+EGlCmExit(void)
+{
+   Dprintf("%s\n", __func__);
+
+   if (!eglcm.ctx)
+      return;
+
+   glXMakeContextCurrent(disp, NoXID, NoXID, NULL);
+   glXDestroyContext(disp, eglcm.ctx);
+   eglcm.ctx = NULL;
+}
+
+static void
+_EGlCmTexParams(ETexture * et, int repeat)
+{
+   glTexParameteri(et->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(et->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(et->target, GL_TEXTURE_WRAP_S,
+		   repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+   glTexParameteri(et->target, GL_TEXTURE_WRAP_T,
+		   repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+}
+
+ETexture           *
+EGlCmTextureFromPixmap(EX_Pixmap pmap, int depth, int w, int h, int repeat)
+{
+   static const int    attrs_rgb[] = {
+      GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+      GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
+      0
+   };
+   static const int    attrs_rgba[] = {
+      GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+      GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGBA_EXT,
+      0
+   };
+   ETexture           *et;
+   int                 j;
+
+   j = (depth == 32) ? 1 : 0;
+   if (pmap == NoXID || !eglcm.have_tex[j])
+      return NULL;
+
+   _EGlCmMakeCurrent();
+
+   et = ECALLOC(ETexture, 1);
+   if (!et)
+      return NULL;
+
+   et->type = ETEX_TYPE_PIXMAP;
+   et->target = GL_TEXTURE_2D;
+   et->y_inverted = eglcm.y_inverted[j];
+   et->w = w;
+   et->h = h;
+   glGenTextures(1, &et->texture);
+   glBindTexture(et->target, et->texture);
+   _EGlCmTexParams(et, repeat);
+
+   et->glxpmap = glXCreatePixmap(disp, eglcm.fbc_tex[j], pmap,
+				 (j == 1) ? attrs_rgba : attrs_rgb);
+   if (et->glxpmap != NoXID)
+      _glXBindTexImageEXT(disp, et->glxpmap, GLX_FRONT_LEFT_EXT, NULL);
+
+   D2printf("%s: pmap=%#x depth=%d %dx%d: tex=%u glxpmap=%#x\n", __func__,
+	    pmap, depth, w, h, et->texture, et->glxpmap);
+
+   return et;
+}
+
+ETexture           *
+EGlCmTextureFromAlpha(const unsigned char *data, int stride, int w, int h)
+{
+   ETexture           *et;
+
+   _EGlCmMakeCurrent();
+
+   et = ECALLOC(ETexture, 1);
+   if (!et)
+      return NULL;
+
+   et->type = ETEX_TYPE_IMAGE;
+   et->target = GL_TEXTURE_2D;
+   et->y_inverted = 1;
+   et->w = w;
+   et->h = h;
+   glGenTextures(1, &et->texture);
+   glBindTexture(et->target, et->texture);
+   _EGlCmTexParams(et, 0);
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+   glTexImage2D(et->target, 0, GL_ALPHA8, w, h, 0, GL_ALPHA,
+		GL_UNSIGNED_BYTE, data);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+   return et;
+}
+
+/* Pick up new pixmap contents (required by non-zero-copy implementations) */
+void
+EGlCmTextureRebind(ETexture * et)
+{
+   if (!et || et->glxpmap == NoXID)
+      return;
+
+   glBindTexture(et->target, et->texture);
+   _glXReleaseTexImageEXT(disp, et->glxpmap, GLX_FRONT_LEFT_EXT);
+   _glXBindTexImageEXT(disp, et->glxpmap, GLX_FRONT_LEFT_EXT, NULL);
+}
+
+void
+EGlCmTextureDestroy(ETexture * et)
+{
+   if (!et)
+      return;
+
+   if (!eglcm.ctx)
+     {
+	/* Context gone - only the GLX pixmap remains */
+	if (et->glxpmap != NoXID)
+	   glXDestroyPixmap(disp, et->glxpmap);
+	Efree(et);
+	return;
+     }
+
+   _EGlCmMakeCurrent();
+   EGlTextureDestroy(et);
+}
+
+void
+EGlCmFrameBegin(int w, int h, const XRectangle * box)
+{
+   _EGlCmMakeCurrent();
+
+   if (w != eglcm.w || h != eglcm.h)
+     {
+	eglcm.w = w;
+	eglcm.h = h;
+	glViewport(0, 0, w, h);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, w, h, 0, -1, 1);	/* X11 coordinates */
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+     }
+
+   glScissor(box->x, h - box->y - box->height, box->width, box->height);
+}
+
+void
+EGlCmFrameEnd(const XRectangle * box)
+{
+   if (eglcm.copy_sub_buffer)
+      eglcm.copy_sub_buffer(disp, eglcm.xwin, box->x,
+			    eglcm.h - box->y - box->height,
+			    box->width, box->height);
+   else
+      glXSwapBuffers(disp, eglcm.xwin);
+   glFlush();
+}
+
+/* Is the back buffer preserved between frames? */
+int
+EGlCmPartialUpdates(void)
+{
+   return eglcm.copy_sub_buffer != NULL;
+}
+
+void
+EGlCmFill(int x, int y, int w, int h, float r, float g, float b)
+{
+   glDisable(GL_TEXTURE_2D);
+   glColor4f(r, g, b, 1.f);
+   glRecti(x, y, x + w, y + h);
+   glEnable(GL_TEXTURE_2D);
+}
+
+void
+EGlCmDraw(ETexture * et, int mode, int sx, int sy, int sw, int sh,
+	  int dx, int dy, int dw, int dh, float r, float g, float b, float a)
+{
+   GLfloat             s0, s1, t0, t1;
+
+   if (!et || et->w == 0 || et->h == 0)
+      return;
+
+   glBindTexture(et->target, et->texture);
+
+   switch (mode)
+     {
+     default:
+     case EGL_CM_MODULATE:
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	break;
+     case EGL_CM_SHADOW:
+	/* rgb = color.rgb * tex.a, a = color.a * tex.a */
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PRIMARY_COLOR);
+	glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_TEXTURE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_ALPHA);
+	glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_MODULATE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_PRIMARY_COLOR);
+	glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, GL_TEXTURE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_SRC_ALPHA);
+	break;
+     }
+
+   s0 = (GLfloat) sx / et->w;
+   s1 = (GLfloat) (sx + sw) / et->w;
+   t0 = (GLfloat) sy / et->h;
+   t1 = (GLfloat) (sy + sh) / et->h;
+   if (!et->y_inverted)
+     {
+	t0 = 1.f - t0;
+	t1 = 1.f - t1;
+     }
+
+   glColor4f(r, g, b, a);
+   glBegin(GL_QUADS);
+   glTexCoord2f(s0, t0);
+   glVertex2i(dx, dy);
+   glTexCoord2f(s1, t0);
+   glVertex2i(dx + dw, dy);
+   glTexCoord2f(s1, t1);
+   glVertex2i(dx + dw, dy + dh);
+   glTexCoord2f(s0, t1);
+   glVertex2i(dx, dy + dh);
+   glEnd();
+}
+
+#if ENABLE_BENCHMARKS
+void
+EGlCmFinish(void)
+{
+   _EGlCmMakeCurrent();
+   glFinish();
+}
+#endif
+
 #include "eobj.h"
 
 static void
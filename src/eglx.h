@@ -32,7 +32,9 @@ struct _glhook {
    unsigned int        texture;
    unsigned short      target;
    unsigned char       type;
+   unsigned char       y_inverted;
    unsigned int        glxpmap;
+   unsigned short      w, h;
 };
 
 int                 EGlInit(void);
@@ -49,4 +51,29 @@ ETexture           *EGlTextureFromDrawable(EX_Drawable draw, int mode);
 void                EGlTextureDestroy(ETexture * et);
 void                EGlTextureInvalidate(ETexture * et);
 
+/* Compositor support */
+#define EGL_CM_MODULATE     0	/* Texture * color */
+#define EGL_CM_SHADOW       1	/* Color * texture alpha */
+
+int                 EGlCmInit(EX_Window xwin, Visual * vis);
+void                EGlCmExit(void);
+ETexture           *EGlCmTextureFromPixmap(EX_Pixmap pmap, int depth,
+					   int w, int h, int repeat);
+ETexture           *EGlCmTextureFromAlpha(const unsigned char *data,
+					  int stride, int w, int h);
+void                EGlCmTextureRebind(ETexture * et);
+void                EGlCmTextureDestroy(ETexture * et);
+void                EGlCmFrameBegin(int w, int h, const XRectangle * box);
+void                EGlCmFrameEnd(const XRectangle * box);
+int                 EGlCmPartialUpdates(void);
+void                EGlCmFill(int x, int y, int w, int h,
+			      float r, float g, float b);
+void                EGlCmDraw(ETexture * et, int mode,
+			      int sx, int sy, int sw, int sh,
+			      int dx, int dy, int dw, int dh,
+			      float r, float g, float b, float a);
+#if ENABLE_BENCHMARKS
+void                EGlCmFinish(void);
+#endif
+
 #endif /* _EGLX_H_ */
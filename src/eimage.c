@@ -488,78 +488,249 @@ EImageApplyToWin(EImage * im, Win win, int flags, int w, int h)
    EClearWindow(win);
 }
 
-void
-ScaleRect(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
-	  int sx, int sy, int sw, int sh,
-	  int dx, int dy, int dw, int dh, int flags)
-{
 #if USE_XRENDER
-   if (Conf.testing.use_render_for_scaling)
-     {
-	XTransform          tr;
-	EX_Picture          psrc, pdst;
-	double              scale_x, scale_y;
+/*
+ * Server side scaling
+ *
+ * Reductions by 2 or more are done as a series of halvings, each sampling
+ * bilinearly at the corner between 2x2 source pixels, i.e. a box average.
+ * The final step, less than 2x, uses the bilinear ("good") filter, or
+ * "best" for high quality intermediate scaling.
+ * Unfiltered scaling is done in one step with the nearest filter.
+ *
+ * The VROOT source picture and the intermediate buffers are kept and
+ * reused, as the same sizes come up over and over (pager updates).
+ */
+#define SCALE_BUF_MAX 8
 
-	scale_x = (double)sw / (double)dw;
-	scale_y = (double)sh / (double)dh;
-	memset(&tr, 0, sizeof(tr));
-	tr.matrix[0][0] = XDoubleToFixed(scale_x);
-	tr.matrix[1][1] = XDoubleToFixed(scale_y);
-	tr.matrix[2][2] = XDoubleToFixed(1.);
+typedef struct {
+   EX_Pixmap           pmap;
+   EX_Picture          pict;
+   Visual             *vis;
+   int                 w, h;
+   unsigned int        used;
+} ScaleBuf;
 
-	psrc = EPictureCreateII(wsrc, src);
-	pdst = EPictureCreateII(wdst, dst);
-
-	XRenderSetPictureFilter(disp, psrc, (flags & EIMAGE_ANTI_ALIAS) ?
-				FilterBest : FilterNearest, NULL, 0);
-	XRenderSetPictureTransform(disp, psrc, &tr);
-	XRenderComposite(disp, PictOpSrc, psrc, NoXID, pdst,
-			 (int)(sx / scale_x + .5), (int)(sy / scale_y + .5),
-			 0, 0, dx, dy, dw, dh);
-	XRenderFreePicture(disp, psrc);
-	XRenderFreePicture(disp, pdst);
+static struct {
+   EX_Picture          root_pict;
+   ScaleBuf            buf[SCALE_BUF_MAX];
+   unsigned int        use_cnt;
+} scale_cache;
+
+static EX_Picture
+_ScaleBufGet(Win win, int w, int h, EX_Picture busy)
+{
+   ScaleBuf           *sb, *lru;
+   Visual             *vis;
+   int                 i;
+
+   vis = WinGetVisual(win);
+   lru = NULL;
+   for (i = 0; i < SCALE_BUF_MAX; i++)
+     {
+	sb = scale_cache.buf + i;
+	if (sb->pict == busy && sb->pict != NoXID)
+	   continue;
+	if (sb->pict != NoXID && sb->vis == vis && sb->w == w && sb->h == h)
+	  {
+	     sb->used = ++scale_cache.use_cnt;
+	     return sb->pict;
+	  }
+	if (!lru || sb->used < lru->used)
+	   lru = sb;
      }
-   else
+
+   sb = lru;
+   if (sb->pict != NoXID)
+     {
+	EPictureDestroy(sb->pict);
+	EFreePixmap(sb->pmap);
+     }
+   sb->pict = EPictureCreateBuffer(win, w, h, 0, &sb->pmap);
+   sb->vis = vis;
+   sb->w = w;
+   sb->h = h;
+   sb->used = ++scale_cache.use_cnt;
+
+   return sb->pict;
+}
+
+static void
+_PictureSetScale(EX_Picture pict, double x0, double y0, double fx, double fy,
+		 const char *filter, int repeat)
+{
+   XTransform          tr;
+   XRenderPictureAttributes pa;
+
+   memset(&tr, 0, sizeof(tr));
+   tr.matrix[0][0] = XDoubleToFixed(fx);
+   tr.matrix[0][2] = XDoubleToFixed(x0);
+   tr.matrix[1][1] = XDoubleToFixed(fy);
+   tr.matrix[1][2] = XDoubleToFixed(y0);
+   tr.matrix[2][2] = XDoubleToFixed(1.);
+   XRenderSetPictureTransform(disp, pict, &tr);
+   XRenderSetPictureFilter(disp, pict, filter, NULL, 0);
+
+#if RENDER_VERSION >= VERS(0, 10)
+   /* Pad rather than fade to black at the edges when filtering */
+   if (repeat < 0)
+      repeat = (ExtVersion(XEXT_RENDER) >= VERS(0, 10)) ?
+	 RepeatPad : RepeatNone;
+#else
+   if (repeat < 0)
+      repeat = RepeatNone;
 #endif
+   pa.repeat = repeat;
+   XRenderChangePicture(disp, pict, CPRepeat, &pa);
+}
+
+static void
+_ScaleRenderPict(EX_Picture psrc, int tile, Win wdst, EX_Picture pdst,
+		 int sx, int sy, int sw, int sh,
+		 int dx, int dy, int dw, int dh, int flags)
+{
+   EX_Picture          pict, pnew;
+   double              x0, y0, rw, rh;
+   const char         *filter;
+   int                 cw, ch, nw, nh, hx, hy, repeat;
+
+   repeat = (tile) ? RepeatNormal : -1;
+   pict = psrc;
+   x0 = sx;
+   y0 = sy;
+   rw = sw;
+   rh = sh;
+
+   if (!(flags & (EIMAGE_ANTI_ALIAS | EIMAGE_ISCALE)))
      {
-	int                 scale;
-	Imlib_Image         im;
+	filter = FilterNearest;
+	goto final;
+     }
 
-	if (flags & (EIMAGE_ISCALE))
-	  {
-	     scale = (flags & EIMAGE_ISCALE) >> 8;
-	     im = EImageGrabDrawableScaled(wsrc, src, NoXID, sx, sy, sw, sh,
-					   scale * dw, scale * dh, 0, 0);
-	     flags |= EIMAGE_ANTI_ALIAS;
-	  }
-	else
-	  {
-	     im = EImageGrabDrawableScaled(wsrc, src, NoXID, sx, sy, sw, sh,
-					   sw, sh, 0, 0);
-	  }
+   /* Box filtered halvings while reducing by 2 or more */
+   cw = sw;
+   ch = sh;
+   for (;;)
+     {
+	hx = rw >= 2. * dw;
+	hy = rh >= 2. * dh;
+	if (!hx && !hy)
+	   break;
 
-	EImageRenderOnDrawable(im, wdst, dst, flags, dx, dy, dw, dh);
-	imlib_free_image();
+	nw = (hx) ? (cw + 1) / 2 : cw;
+	nh = (hy) ? (ch + 1) / 2 : ch;
+	pnew = _ScaleBufGet(wdst, nw, nh, pict);
+	_PictureSetScale(pict, x0, y0, (hx) ? 2. : 1., (hy) ? 2. : 1.,
+			 FilterBilinear, (pict == psrc) ? repeat : -1);
+	XRenderComposite(disp, PictOpSrc, pict, NoXID, pnew,
+			 0, 0, 0, 0, 0, 0, nw, nh);
+
+	pict = pnew;
+	x0 = y0 = 0.;
+	if (hx)
+	   rw /= 2.;
+	if (hy)
+	   rh /= 2.;
+	cw = nw;
+	ch = nh;
      }
+   filter = ((flags & EIMAGE_ISCALE) >= 0x200) ? FilterBest : FilterGood;
+
+ final:
+   _PictureSetScale(pict, x0, y0, rw / dw, rh / dh, filter,
+		    (pict == psrc) ? repeat : -1);
+   XRenderComposite(disp, PictOpSrc, pict, NoXID, pdst,
+		    0, 0, 0, 0, dx, dy, dw, dh);
 }
 
+static void
+_ScaleRender(Win wsrc, EX_Drawable src, int tile, Win wdst, EX_Pixmap dst,
+	     int sx, int sy, int sw, int sh,
+	     int dx, int dy, int dw, int dh, int flags)
+{
+   EX_Picture          psrc, pdst;
+
+   if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
+      return;
+
+   if (wsrc == VROOT && src == WinGetXwin(VROOT) && !tile)
+     {
+	if (scale_cache.root_pict == NoXID)
+	   scale_cache.root_pict = EPictureCreateII(VROOT, src);
+	psrc = scale_cache.root_pict;
+     }
+   else
+     {
+	psrc = EPictureCreateII(wsrc, src);
+     }
+   pdst = EPictureCreate(wdst, dst);
+
+   _ScaleRenderPict(psrc, tile, wdst, pdst, sx, sy, sw, sh,
+		    dx, dy, dw, dh, flags);
+
+   if (psrc != scale_cache.root_pict)
+      EPictureDestroy(psrc);
+   EPictureDestroy(pdst);
+}
+
+/*
+ * Scale from a picture owned by someone else (e.g. the compositor's
+ * window pictures). The picture is left untransformed and unfiltered.
+ */
 void
-ScaleTile(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
-	  int dx, int dy, int dw, int dh, int scale)
+ScalePicture(EX_Picture psrc, Win wdst, EX_Pixmap dst,
+	     int sx, int sy, int sw, int sh,
+	     int dx, int dy, int dw, int dh, int flags)
 {
-   Imlib_Image         im, tim;
-   int                 sw, sh, stw, sth, tw, th;
+   EX_Picture          pdst;
 
-   sw = WinGetW(wsrc);
-   sh = WinGetH(wsrc);
-   EXGetGeometry(src, NULL, NULL, NULL, &stw, &sth, NULL, NULL);
-   if (stw >= sw && sth >= sh)
+   if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
+      return;
+
+   pdst = EPictureCreate(wdst, dst);
+
+   _ScaleRenderPict(psrc, 0, wdst, pdst, sx, sy, sw, sh,
+		    dx, dy, dw, dh, flags);
+   _PictureSetScale(psrc, 0., 0., 1., 1., FilterNearest, RepeatNone);
+
+   EPictureDestroy(pdst);
+}
+#endif /* USE_XRENDER */
+
+static void
+_ScaleRectImlib(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
+		int sx, int sy, int sw, int sh,
+		int dx, int dy, int dw, int dh, int flags)
+{
+   int                 scale;
+   Imlib_Image         im;
+
+   if (flags & (EIMAGE_ISCALE))
      {
-	ScaleRect(wsrc, src, wdst, dst, 0, 0, sw, sh, dx, dy, dw, dh, scale);
-	return;
+	scale = (flags & EIMAGE_ISCALE) >> 8;
+	im = EImageGrabDrawableScaled(wsrc, src, NoXID, sx, sy, sw, sh,
+				      scale * dw, scale * dh, 0, 0);
+	flags |= EIMAGE_ANTI_ALIAS;
+     }
+   else
+     {
+	im = EImageGrabDrawableScaled(wsrc, src, NoXID, sx, sy, sw, sh,
+				      sw, sh, 0, 0);
      }
 
-   /* Source Drawawble is smaller than source window - do scaled tiling */
+   EImageRenderOnDrawable(im, wdst, dst, flags, dx, dy, dw, dh);
+   imlib_free_image();
+}
+
+static void
+_ScaleTileImlib(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
+		int stw, int sth, int dx, int dy, int dw, int dh, int scale)
+{
+   Imlib_Image         im, tim;
+   int                 sw, sh, tw, th;
+
+   sw = WinGetW(wsrc);
+   sh = WinGetH(wsrc);
 
    scale = (scale) ? 2 : 1;
 
@@ -579,6 +750,56 @@ ScaleTile(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
    imlib_free_image();
 }
 
+static int
+_ScaleUseRender(void)
+{
+#if USE_XRENDER
+   return Conf.testing.use_render_for_scaling && ExtVersion(XEXT_RENDER);
+#else
+   return 0;
+#endif
+}
+
+void
+ScaleRect(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
+	  int sx, int sy, int sw, int sh,
+	  int dx, int dy, int dw, int dh, int flags)
+{
+#if USE_XRENDER
+   if (_ScaleUseRender())
+      _ScaleRender(wsrc, src, 0, wdst, dst, sx, sy, sw, sh,
+		   dx, dy, dw, dh, flags);
+   else
+#endif
+      _ScaleRectImlib(wsrc, src, wdst, dst, sx, sy, sw, sh,
+		      dx, dy, dw, dh, flags);
+}
+
+void
+ScaleTile(Win wsrc, EX_Drawable src, Win wdst, EX_Pixmap dst,
+	  int dx, int dy, int dw, int dh, int scale)
+{
+   int                 sw, sh, stw, sth;
+
+   sw = WinGetW(wsrc);
+   sh = WinGetH(wsrc);
+   EXGetGeometry(src, NULL, NULL, NULL, &stw, &sth, NULL, NULL);
+   if (stw >= sw && sth >= sh)
+     {
+	ScaleRect(wsrc, src, wdst, dst, 0, 0, sw, sh, dx, dy, dw, dh, scale);
+	return;
+     }
+
+   /* Source Drawawble is smaller than source window - do scaled tiling */
+#if USE_XRENDER
+   if (_ScaleUseRender())
+      _ScaleRender(wsrc, src, 1, wdst, dst, 0, 0, sw, sh,
+		   dx, dy, dw, dh, scale | EIMAGE_ANTI_ALIAS);
+   else
+#endif
+      _ScaleTileImlib(wsrc, src, wdst, dst, stw, sth, dx, dy, dw, dh, scale);
+}
+
 #if 0				/* Unused */
 void
 EDrawableDumpImage(EX_Drawable draw, const char *txt)
@@ -666,3 +887,66 @@ EImageColorModifierSetTables(EImageColorModifier * icm,
    imlib_set_color_modifier_tables(r, g, b, a);
    imlib_context_set_color_modifier(NULL);
 }
+
+#if ENABLE_BENCHMARKS
+void
+ScaleBench(int n)
+{
+   /* Source size 0: root size, < 0: root size / -n */
+   static const struct {
+      short               sw, sh, dw, dh;
+      int                 flags;
+      const char         *txt;
+   } tests[] = {
+      { 0, 0, 160, 120, 0x100, "pager    " },
+      { 0, 0, 160, 120, 0x200, "pager hiq" },
+      { -160, 0, 1, 120, 0x200, "strip hiq" },
+      { 0, 0, 512, 384, EIMAGE_ANTI_ALIAS, "reduce aa" },
+      { 200, 150, 400, 300, EIMAGE_ANTI_ALIAS, "zoom x2  " },
+   };
+   EX_Pixmap           pmap;
+   unsigned int        t0, t1, t2;
+   int                 i, j, sw, sh, dw, dh, render;
+
+   if (n <= 0)
+      n = 20;
+   render = Conf.testing.use_render_for_scaling;
+
+   IpcPrintf("Scale root window, %d iterations        imlib2 ms   render ms\n",
+	     n);
+   for (j = 0; j < (int)(sizeof(tests) / sizeof(tests[0])); j++)
+     {
+	sw = tests[j].sw;
+	if (sw <= 0)
+	   sw = (sw) ? WinGetW(VROOT) / -sw : WinGetW(VROOT);
+	sh = tests[j].sh;
+	if (sh <= 0)
+	   sh = (sh) ? WinGetH(VROOT) / -sh : WinGetH(VROOT);
+	dw = tests[j].dw;
+	dh = tests[j].dh;
+	pmap = ECreatePixmap(VROOT, dw, dh, 0);
+
+	Conf.testing.use_render_for_scaling = 0;
+	ESync(0);
+	t0 = GetTimeUs();
+	for (i = 0; i < n; i++)
+	   ScaleRect(VROOT, WinGetXwin(VROOT), VROOT, pmap,
+		     0, 0, sw, sh, 0, 0, dw, dh, tests[j].flags);
+	ESync(0);
+	t1 = GetTimeUs();
+	Conf.testing.use_render_for_scaling = 1;
+	for (i = 0; i < n; i++)
+	   ScaleRect(VROOT, WinGetXwin(VROOT), VROOT, pmap,
+		     0, 0, sw, sh, 0, 0, dw, dh, tests[j].flags);
+	ESync(0);
+	t2 = GetTimeUs();
+
+	EFreePixmap(pmap);
+
+	IpcPrintf("%s %4dx%-4d -> %4dx%-4d %9.3f %11.3f\n", tests[j].txt,
+		  sw, sh, dw, dh, 1e-3 * (t1 - t0) / n, 1e-3 * (t2 - t1) / n);
+     }
+
+   Conf.testing.use_render_for_scaling = render;
+}
+#endif /* ENABLE_BENCHMARKS */
@@ -108,6 +108,14 @@ void                ScaleRect(Win wsrc, EX_Drawable src, Win wdst,
 void                ScaleTile(Win wsrc, EX_Drawable src, Win wdst,
 			      EX_Pixmap dst, int dx, int dy, int dw, int dh,
 			      int flags);
+#if USE_XRENDER
+void                ScalePicture(EX_Picture psrc, Win wdst, EX_Pixmap dst,
+				 int sx, int sy, int sw, int sh,
+				 int dx, int dy, int dw, int dh, int flags);
+#endif
+#if ENABLE_BENCHMARKS
+void                ScaleBench(int n);
+#endif
 
 void                EDrawableDumpImage(EX_Drawable draw, const char *txt);
 
@@ -490,16 +490,17 @@ EobjReparent(EObj * eo, EObj * dst, int x, int y)
 
 	if (eo->stacked < 0)
 	  {
-	     eo->desk = NULL;
+	     EobjSetDesk(eo, NULL);
 	     eo->stacked = 0;
 	  }
 	if (eo->desk != dsk)
 	   DeskSetDirtyStack(dsk, eo);
+	eo->stack_gen = 0;	/* Now on top, position unknown */
 #if USE_COMPOSITE
 	if (eo->cmhook)
 	   ECompMgrWinReparent(eo, dsk, move);
 #endif
-	eo->desk = dsk;
+	EobjSetDesk(eo, dsk);
      }
    else
      {
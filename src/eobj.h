@@ -61,6 +61,9 @@ struct _eobj {
    struct _glhook     *glhook;
 #endif
    Animator           *animations;	/* list of pending animations */
+   int                 lpos[3];	/* Positions in stack/focus/order lists */
+   unsigned int        stack_gen;	/* Desk restack generation */
+   int                 stack_pos;	/* Position at that restack */
 };
 
 #define EOBJ_TYPE_EWIN      0
@@ -113,7 +116,7 @@ struct _eobj {
 #define EoSetGone(eo)           EoObj(eo)->gone = 1
 #define EoSetSticky(eo, _x)     EoObj(eo)->sticky = ((_x)?1:0)
 #define EoSetFloating(eo, _f)   EobjSetFloating(EoObj(eo), (_f))
-#define EoSetDesk(eo, _x)       EoObj(eo)->desk = (_x)
+#define EoSetDesk(eo, _x)       EobjSetDesk(EoObj(eo), _x)
 #define EoSetLayer(eo, _l)      EobjSetLayer(EoObj(eo), (_l))
 #define EoChangeOpacity(eo, _o) EobjChangeOpacity(EoObj(eo), _o)
 #define EoSetFade(eo, _x)       EoObj(eo)->fade = (_x)
@@ -196,6 +199,7 @@ int                 EobjListStackCheck(EObj * eo);
 EObj               *EobjListStackFind(EX_Window win);
 EObj               *const *EobjListStackGet(int *num);
 EObj               *const *EobjListStackGetForDesk(int *num, Desk * dsk);
+void                EobjSetDesk(EObj * eo, Desk * dsk);
 void                EobjListFocusAdd(EObj * eo, int ontop);
 void                EobjListFocusDel(EObj * eo);
 int                 EobjListFocusRaise(EObj * eo);
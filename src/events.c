@@ -24,6 +24,11 @@
 #include "config.h"
 
 #include <sys/time.h>
+#if USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#endif
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/extensions/shape.h>
@@ -61,6 +66,7 @@
 #include "ecompmgr.h"
 #include "emodule.h"
 #include "events.h"
+#include "ipc.h"
 #include "timers.h"
 #include "tooltips.h"
 #include "xwin.h"
@@ -352,6 +358,35 @@ struct _EventFdDesc {
 static int          nfds = 0;
 static EventFdDesc *pfds = NULL;
 
+#if USE_EPOLL
+/*
+ * epoll based fd handling.
+ * Entry ix in pfds is registered with data.u32 = ix. The timer fd is
+ * registered with data.u32 = EPOLL_IX_TIMER.
+ */
+#define EPOLL_IX_TIMER 0xffffffff
+#define EPOLL_MAX_EVENTS 16
+
+static int          ep_fd = -1;	/* epoll fd, -1: use select() */
+static int          ep_tfd = -1;	/* timerfd for timers/frame deadline */
+static char         ep_xfd_off;	/* X fd is out of the epoll set (blocked) */
+
+static int
+_EventFdEpollCtl(int op, int fd, unsigned int ix)
+{
+   struct epoll_event  eev;
+
+   eev.events = EPOLLIN;
+   eev.data.u32 = ix;
+   if (epoll_ctl(ep_fd, op, fd, &eev) == 0)
+      return 0;
+
+   if (op != EPOLL_CTL_DEL || (errno != EBADF && errno != ENOENT))
+      Eprintf("*** %s: op=%d fd=%d: %s\n", __func__, op, fd, strerror(errno));
+   return -1;
+}
+#endif
+
 EventFdDesc        *
 EventFdRegister(int fd, EventFdHandler * handler)
 {
@@ -360,12 +395,21 @@ EventFdRegister(int fd, EventFdHandler * handler)
    pfds[nfds - 1].fd = fd;
    pfds[nfds - 1].handler = handler;
 
+#if USE_EPOLL
+   if (ep_fd >= 0)
+      _EventFdEpollCtl(EPOLL_CTL_ADD, fd, nfds - 1);
+#endif
+
    return pfds + (nfds - 1);
 }
 
 void
 EventFdUnregister(EventFdDesc * efd)
 {
+#if USE_EPOLL
+   if (ep_fd >= 0 && efd->fd >= 0)
+      _EventFdEpollCtl(EPOLL_CTL_DEL, efd->fd, 0);
+#endif
    efd->fd = -1;
 }
 
@@ -480,6 +524,9 @@ HandleEvent(XEvent * ev)
 
    win = ELookupXwin(ev->xany.window);
 
+   if (ev->type >= KeyPress && ev->type <= MotionNotify)
+      Mode.events.input_time_ms = Mode.events.time_ms;
+
    switch (ev->type)
      {
      case KeyPress:
@@ -609,13 +656,155 @@ HandleEvent(XEvent * ev)
      }
 }
 
+/*
+ * Event compression
+ *
+ * The fetched events are indexed per window in one forward pass. Each event
+ * is linked into the chain of its subject window and, if different, into the
+ * chain of its event window (xany.window). Each EnterNotify is also linked to
+ * the previous EnterNotify on the same window. The compression pass (walking
+ * backwards from the latest event) then only visits events on the window in
+ * question.
+ */
+typedef struct {
+   EX_Window           win;	/* Subject window */
+   int                 wprev[2];	/* Previous event on subject/event window */
+   int                 eprev;	/* Previous EnterNotify on same window */
+} EvLink;
+
+/* Previous event on window win, before event ix (on win) */
+#define EV_PREV(ix, w) evc.links[ix].wprev[evc.links[ix].win != (w)]
+
+typedef struct {
+   EX_Window           win;
+   int                 last;	/* Last event on window */
+   int                 enter;	/* Last EnterNotify on window */
+} EvWinSlot;
+
+static struct {
+   EvLink             *links;
+   int                 links_n;
+   EvWinSlot          *slots;
+   unsigned int        slots_n;	/* Power of 2 */
+   unsigned int        dropped[128];	/* Per event type */
+} evc;
+
+#define EV_DROP(_type, _n) \
+   do { if ((unsigned int)(_type) < 128) evc.dropped[_type] += (_n); } while(0)
+
+static              EX_Window
+_EvSubjectWin(const XEvent * ev)
+{
+   switch (ev->type)
+     {
+     case CreateNotify:
+	return ev->xcreatewindow.window;
+     case DestroyNotify:
+	return ev->xdestroywindow.window;
+     case UnmapNotify:
+	return ev->xunmap.window;
+     case MapNotify:
+	return ev->xmap.window;
+     case MapRequest:
+	return ev->xmaprequest.window;
+     case ReparentNotify:
+	return ev->xreparent.window;
+     case ConfigureRequest:
+	return ev->xconfigurerequest.window;
+     default:
+	return ev->xany.window;
+     }
+}
+
+static EvWinSlot   *
+_EvWinSlotGet(EX_Window win)
+{
+   EvWinSlot          *slot;
+   unsigned int        i, mask;
+
+   mask = evc.slots_n - 1;
+   for (i = (unsigned int)(win * 2654435761u) & mask;; i = (i + 1) & mask)
+     {
+	slot = evc.slots + i;
+	if (slot->win == win)
+	   return slot;
+	if (slot->last < 0)
+	  {
+	     slot->win = win;
+	     return slot;
+	  }
+     }
+}
+
+static void
+_EvIndexBuild(const XEvent * evq, int count)
+{
+   const XEvent       *ev;
+   EvWinSlot          *slot;
+   unsigned int        i, n;
+
+   if (count > evc.links_n)
+     {
+	evc.links_n = count;
+	evc.links = EREALLOC(EvLink, evc.links, evc.links_n);
+     }
+
+   /* Each event may add two windows, keep the table at most half full */
+   for (n = 16; n < 4 * (unsigned int)count;)
+      n *= 2;
+   if (n > evc.slots_n)
+     {
+	evc.slots_n = n;
+	evc.slots = EREALLOC(EvWinSlot, evc.slots, evc.slots_n);
+     }
+   for (i = 0; i < n; i++)
+      evc.slots[i].last = evc.slots[i].enter = -1;
+   evc.slots_n = n;
+
+   for (i = 0; i < (unsigned int)count; i++)
+     {
+	ev = evq + i;
+	evc.links[i].win = _EvSubjectWin(ev);
+	slot = _EvWinSlotGet(evc.links[i].win);
+	evc.links[i].wprev[0] = slot->last;
+	evc.links[i].eprev = slot->enter;
+	slot->last = i;
+	if (ev->type == EnterNotify)
+	   slot->enter = i;
+	if (ev->xany.window == evc.links[i].win)
+	   continue;
+	slot = _EvWinSlotGet(ev->xany.window);
+	evc.links[i].wprev[1] = slot->last;
+	slot->last = i;
+     }
+}
+
+/* Find latest remaining EnterNotify before LeaveNotify at ix (-1 if none) */
+static int
+_EvFindEnter(const XEvent * evq, int ix)
+{
+   EvLink             *links = evc.links;
+   int                 j;
+
+   for (j = links[ix].eprev; j >= 0; j = links[j].eprev)
+     {
+	if (evq[j].type == EnterNotify)
+	   break;
+	/* Skip discarded EnterNotify's on later lookups */
+	links[ix].eprev = links[j].eprev;
+     }
+
+   return j;
+}
+
 static void
 EventsCompress(XEvent * evq, int count)
 {
    XEvent             *ev, *ev2;
    int                 i, j, n;
    int                 xa, ya, xb, yb;
-   int                 type;
+   int                 type, motion_seen;
+   EX_Window           win;
 
 #if ENABLE_DEBUG_EVENTS
    /* Debug - should be taken out */
@@ -626,6 +815,13 @@ EventsCompress(XEvent * evq, int count)
 		    EventName(evq[i].type), evq[i].xany.window);
 #endif
 
+   if (count <= 0)
+      return;
+
+   _EvIndexBuild(evq, count);
+
+   motion_seen = 0;
+
    /* Loop through event list, starting with latest */
    for (i = count - 1; i >= 0; i--)
      {
@@ -641,47 +837,37 @@ EventsCompress(XEvent * evq, int count)
 
 	  case MotionNotify:
 	     /* Discard all but last motion event */
-	     j = i - 1;
-	     n = 0;
-	     for (; j >= 0; j--)
+	     if (!motion_seen)
 	       {
-		  ev2 = evq + j;
-		  if (ev2->type == type)
-		    {
-		       n++;
-		       ev2->type = 0;
-		    }
+		  motion_seen = 1;
+		  break;
 	       }
+	     ev->type = 0;
+	     EV_DROP(type, 1);
 #if ENABLE_DEBUG_EVENTS
-	     if (n && EDebug(EDBUG_TYPE_COMPRESSION))
+	     if (EDebug(EDBUG_TYPE_COMPRESSION))
 		Eprintf("%s: n=%4d %s %#lx x,y = %d,%d\n", __func__,
-			n, EventName(type), ev->xmotion.window,
+			1, EventName(type), ev->xmotion.window,
 			ev->xmotion.x, ev->xmotion.y);
 #endif
 	     break;
 
 	  case LeaveNotify:
-	     for (j = i - 1; j >= 0; j--)
-	       {
-		  ev2 = evq + j;
-		  if (ev2->type == EnterNotify)
-		    {
-		       if (ev2->xcrossing.window == ev->xcrossing.window)
-			  goto do_enter_leave_nuked;
-		    }
-	       }
-	     break;
-	   do_enter_leave_nuked:
-	     ev2->type = ev->type = 0;
-	     for (n = i - 1; n > j; n--)
+	     j = _EvFindEnter(evq, i);
+	     if (j < 0)
+		break;
+	     evq[j].type = ev->type = 0;
+	     EV_DROP(EnterNotify, 1);
+	     EV_DROP(LeaveNotify, 1);
+	     /* Discard motion on this window between enter and leave */
+	     win = ev->xcrossing.window;
+	     for (n = EV_PREV(i, win); n > j; n = EV_PREV(n, win))
 	       {
 		  ev2 = evq + n;
-		  if (ev2->type == MotionNotify)
-		    {
-		       if (ev2->xmotion.window != ev->xmotion.window)
-			  continue;
-		       ev2->type = 0;
-		    }
+		  if (ev2->type != MotionNotify)
+		     continue;
+		  ev2->type = 0;
+		  EV_DROP(MotionNotify, 1);
 	       }
 #if ENABLE_DEBUG_EVENTS
 	     if (EDebug(EDBUG_TYPE_COMPRESSION))
@@ -691,49 +877,50 @@ EventsCompress(XEvent * evq, int count)
 	     break;
 
 	  case DestroyNotify:
-	     for (j = i - 1; j >= 0; j--)
+	     win = ev->xdestroywindow.window;
+	     for (j = EV_PREV(i, win); j >= 0; j = EV_PREV(j, win))
 	       {
 		  ev2 = evq + j;
 		  switch (ev2->type)
 		    {
 		    case CreateNotify:
-		       if (ev2->xcreatewindow.window !=
-			   ev->xdestroywindow.window)
+		       if (ev2->xcreatewindow.window != win)
 			  continue;
 		       ev2->type = EX_EVENT_CREATE_GONE;
 		       goto loop_quit_DestroyNotify;
 		    case DestroyNotify:
 		       break;
 		    case UnmapNotify:
-		       if (ev2->xunmap.window != ev->xdestroywindow.window)
+		       if (ev2->xunmap.window != win)
 			  continue;
 		       ev2->type = EX_EVENT_UNMAP_GONE;
 		       break;
 		    case MapNotify:
-		       if (ev2->xmap.window != ev->xdestroywindow.window)
+		       if (ev2->xmap.window != win)
 			  continue;
 		       ev2->type = EX_EVENT_MAP_GONE;
 		       break;
 		    case MapRequest:
-		       if (ev2->xmaprequest.window != ev->xdestroywindow.window)
+		       if (ev2->xmaprequest.window != win)
 			  continue;
 		       ev2->type = EX_EVENT_MAPREQUEST_GONE;
 		       break;
 		    case ReparentNotify:
-		       if (ev2->xreparent.window != ev->xdestroywindow.window)
+		       if (ev2->xreparent.window != win)
 			  continue;
 		       ev2->type = EX_EVENT_REPARENT_GONE;
 		       break;
 		    case ConfigureRequest:
-		       if (ev2->xconfigurerequest.window !=
-			   ev->xdestroywindow.window)
+		       if (ev2->xconfigurerequest.window != win)
 			  continue;
+		       EV_DROP(ev2->type, 1);
 		       ev2->type = 0;
 		       break;
 		    default:
 		       /* Nuke all other events on a destroyed window */
-		       if (ev2->xany.window != ev->xdestroywindow.window)
+		       if (ev2->xany.window != win)
 			  continue;
+		       EV_DROP(ev2->type, 1);
 		       ev2->type = 0;
 		       break;
 		    }
@@ -747,23 +934,22 @@ EventsCompress(XEvent * evq, int count)
 	     xb = xa + ev->xexpose.width;
 	     ya = ev->xexpose.y;
 	     yb = ya + ev->xexpose.height;
-	     for (j = i - 1; j >= 0; j--)
+	     win = ev->xexpose.window;
+	     for (j = EV_PREV(i, win); j >= 0; j = EV_PREV(j, win))
 	       {
 		  ev2 = evq + j;
-		  if (ev2->type == type &&
-		      ev2->xexpose.window == ev->xexpose.window)
-		    {
-		       n++;
-		       ev2->type = 0;
-		       if (xa > ev2->xexpose.x)
-			  xa = ev2->xexpose.x;
-		       if (xb < ev2->xexpose.x + ev2->xexpose.width)
-			  xb = ev2->xexpose.x + ev2->xexpose.width;
-		       if (ya > ev2->xexpose.y)
-			  ya = ev2->xexpose.y;
-		       if (yb < ev2->xexpose.y + ev2->xexpose.height)
-			  yb = ev2->xexpose.y + ev2->xexpose.height;
-		    }
+		  if (ev2->type != type)
+		     continue;
+		  n++;
+		  ev2->type = 0;
+		  if (xa > ev2->xexpose.x)
+		     xa = ev2->xexpose.x;
+		  if (xb < ev2->xexpose.x + ev2->xexpose.width)
+		     xb = ev2->xexpose.x + ev2->xexpose.width;
+		  if (ya > ev2->xexpose.y)
+		     ya = ev2->xexpose.y;
+		  if (yb < ev2->xexpose.y + ev2->xexpose.height)
+		     yb = ev2->xexpose.y + ev2->xexpose.height;
 	       }
 	     if (n)
 	       {
@@ -771,6 +957,7 @@ EventsCompress(XEvent * evq, int count)
 		  ev->xexpose.width = xb - xa;
 		  ev->xexpose.y = ya;
 		  ev->xexpose.height = yb - ya;
+		  EV_DROP(type, n);
 	       }
 #if ENABLE_DEBUG_EVENTS
 	     if (EDebug(EDBUG_TYPE_COMPRESSION))
@@ -781,15 +968,17 @@ EventsCompress(XEvent * evq, int count)
 
 	  case EX_EVENT_SHAPE_NOTIFY:
 	     n = 0;
-	     for (j = i - 1; j >= 0; j--)
+	     win = ev->xany.window;
+	     for (j = EV_PREV(i, win); j >= 0; j = EV_PREV(j, win))
 	       {
 		  ev2 = evq + j;
-		  if (ev2->type == type && ev2->xany.window == ev->xany.window)
+		  if (ev2->type == type)
 		    {
 		       n++;
 		       ev2->type = 0;
 		    }
 	       }
+	     EV_DROP(type, n);
 #if ENABLE_DEBUG_EVENTS
 	     if (n && EDebug(EDBUG_TYPE_COMPRESSION))
 		Eprintf("%s: n=%4d %s %#lx\n", __func__,
@@ -801,6 +990,7 @@ EventsCompress(XEvent * evq, int count)
 	  case NoExpose:
 	     /* Not using these */
 	     ev->type = 0;
+	     EV_DROP(type, 1);
 	     break;
 	  }
      }
@@ -815,6 +1005,28 @@ EventsCompress(XEvent * evq, int count)
 #endif
 }
 
+void
+EventsCompressStats(int reset)
+{
+   unsigned int        i, n;
+
+   for (i = n = 0; i < 128; i++)
+     {
+	if (!evc.dropped[i])
+	   continue;
+	n += evc.dropped[i];
+#if ENABLE_DEBUG_EVENTS
+	IpcPrintf("%3d %-20s %10u\n", i, EventName(i), evc.dropped[i]);
+#else
+	IpcPrintf("%3d %10u\n", i, evc.dropped[i]);
+#endif
+     }
+   IpcPrintf("Total dropped: %u\n", n);
+
+   if (reset)
+      memset(evc.dropped, 0, sizeof(evc.dropped));
+}
+
 #if USE_GENERIC
 
 #if USE_XI2
@@ -929,6 +1141,13 @@ _EventFetchPresent(XEvent * ev)
    if (EDebug(EDBUG_TYPE_PRESENT))
       Eprintf("%s: %#lx: type=%d\n",
 	      __func__, xpe->idle.window, xpe->xpe.evtype);
+
+#if USE_COMPOSITE
+   if (xpe->xpe.evtype == PresentCompleteNotify &&
+       xpe->cmpl.kind == PresentCompleteKindPixmap)
+      ECompMgrPresentComplete(xpe->cmpl.window, xpe->cmpl.serial_number,
+			      xpe->cmpl.ust, xpe->cmpl.msc);
+#endif
 }
 #endif /* USE_XPRESENT */
 
@@ -1059,6 +1278,155 @@ EventsProcess(XEvent ** evq_p, int *evq_n, int *evq_f)
    return count;
 }
 
+static void
+_EventsWaitSelect(int dt, int dtl)
+{
+   fd_set              fdset;
+   struct timeval      tval;
+   int                 count, fdsize, fd, i;
+
+   FD_ZERO(&fdset);
+   fdsize = -1;
+   for (i = 0; i < nfds; i++)
+     {
+	if (Mode.events.block && i == 0)
+	   continue;
+	fd = pfds[i].fd;
+	if (fd < 0)
+	   continue;
+	if (fdsize < fd)
+	   fdsize = fd;
+	FD_SET(fd, &fdset);
+     }
+   fdsize++;
+
+   if (dt > 0.)
+     {
+	tval.tv_sec = (long)dt / 1000;
+	tval.tv_usec = ((long)dt - tval.tv_sec * 1000) * 1000;
+	count = select(fdsize, &fdset, NULL, NULL, &tval);
+     }
+   else
+     {
+	count = select(fdsize, &fdset, NULL, NULL, NULL);
+     }
+
+   if (EDebug(EDBUG_TYPE_EVENTS))
+      Eprintf("%s: count=%d xfd=%d:%d dtl=%.6lf dt=%.6lf\n", __func__,
+	      count, pfds[0].fd, FD_ISSET(pfds[0].fd, &fdset),
+	      dtl * 1e-3, dt * 1e-3);
+
+   if (count <= 0)
+      return;			/* Timeout (or error) */
+
+   /* Excluding X fd */
+   for (i = 1; i < nfds; i++)
+     {
+	fd = pfds[i].fd;
+	if ((fd >= 0) && (FD_ISSET(fd, &fdset)))
+	  {
+	     if (EDebug(EDBUG_TYPE_EVENTS) > 1)
+		Eprintf("Event fd %d\n", i);
+	     pfds[i].handler();
+	  }
+     }
+}
+
+#if USE_EPOLL
+static void
+_EventsEpollInit(void)
+{
+   int                 i;
+
+   ep_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (ep_fd < 0)
+      goto bail_out;
+
+   ep_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (ep_tfd < 0)
+      goto bail_out;
+   if (_EventFdEpollCtl(EPOLL_CTL_ADD, ep_tfd, EPOLL_IX_TIMER))
+      goto bail_out;
+
+   for (i = 0; i < nfds; i++)
+     {
+	if (pfds[i].fd < 0)
+	   continue;
+	if (_EventFdEpollCtl(EPOLL_CTL_ADD, pfds[i].fd, i))
+	   goto bail_out;
+     }
+   ep_xfd_off = 0;
+
+   if (EDebug(EDBUG_TYPE_EVENTS))
+      Eprintf("%s: epoll fd=%d timer fd=%d\n", __func__, ep_fd, ep_tfd);
+   return;
+
+ bail_out:
+   Eprintf("*** %s: Falling back to select(): %s\n", __func__,
+	   strerror(errno));
+   if (ep_tfd >= 0)
+      close(ep_tfd);
+   if (ep_fd >= 0)
+      close(ep_fd);
+   ep_tfd = ep_fd = -1;
+}
+
+static void
+_EventsWaitEpoll(int dt, int dtl)
+{
+   struct epoll_event  eevs[EPOLL_MAX_EVENTS];
+   struct itimerspec   its;
+   unsigned long long  exp;
+   unsigned int        ix;
+   int                 count, i, xfd_set;
+
+   /* Keep the X fd out of the set while events are blocked, as done by
+    * the select() loop. Otherwise we would spin on pending X input. */
+   if (Mode.events.block != ep_xfd_off)
+     {
+	_EventFdEpollCtl((Mode.events.block) ? EPOLL_CTL_DEL : EPOLL_CTL_ADD,
+			 pfds[0].fd, 0);
+	ep_xfd_off = Mode.events.block;
+     }
+
+   /* Arm the timer fd (dt == 0 disarms it) */
+   its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+   its.it_value.tv_sec = dt / 1000;
+   its.it_value.tv_nsec = (dt - its.it_value.tv_sec * 1000) * 1000000;
+   timerfd_settime(ep_tfd, 0, &its, NULL);
+
+   count = epoll_wait(ep_fd, eevs, EPOLL_MAX_EVENTS, -1);
+
+   if (EDebug(EDBUG_TYPE_EVENTS))
+     {
+	for (i = xfd_set = 0; i < count; i++)
+	   if (eevs[i].data.u32 == 0)
+	      xfd_set = 1;
+	Eprintf("%s: count=%d xfd=%d:%d dtl=%.6lf dt=%.6lf\n", __func__,
+		count, pfds[0].fd, xfd_set, dtl * 1e-3, dt * 1e-3);
+     }
+
+   for (i = 0; i < count; i++)
+     {
+	ix = eevs[i].data.u32;
+	if (ix == EPOLL_IX_TIMER)
+	  {
+	     /* Just drain it, the timers are run by the main loop */
+	     if (read(ep_tfd, &exp, sizeof(exp)) < 0)
+		exp = 0;
+	     continue;
+	  }
+	if (ix == 0)
+	   continue;		/* X fd */
+	if ((int)ix >= nfds || pfds[ix].fd < 0)
+	   continue;		/* Unregistered by an earlier handler */
+	if (EDebug(EDBUG_TYPE_EVENTS) > 1)
+	   Eprintf("Event fd %d\n", ix);
+	pfds[ix].handler();
+     }
+}
+#endif /* USE_EPOLL */
+
 /*
  * This is the primary event loop.  Everything that is going to happen in the
  * window manager has to start here at some point.  This is where all the
@@ -1070,15 +1438,17 @@ EventsMain(void)
    static int          evq_alloc = 0;
    static int          evq_fetch = 0;
    static XEvent      *evq_ptr = NULL;
-   fd_set              fdset;
-   struct timeval      tval;
    unsigned int        time1, time2;
    int                 dtl, dt;
    int                 count, pfetch;
-   int                 fdsize, fd, i;
 
    time1 = GetTimeMs();
 
+#if USE_EPOLL
+   if (Conf.testing.use_epoll)
+      _EventsEpollInit();
+#endif
+
    for (;;)
      {
 	pfetch = 0;
@@ -1127,51 +1497,12 @@ EventsMain(void)
 	else if (XPending(disp))
 	   continue;
 
-	FD_ZERO(&fdset);
-	fdsize = -1;
-	for (i = 0; i < nfds; i++)
-	  {
-	     if (Mode.events.block && i == 0)
-		continue;
-	     fd = pfds[i].fd;
-	     if (fd < 0)
-		continue;
-	     if (fdsize < fd)
-		fdsize = fd;
-	     FD_SET(fd, &fdset);
-	  }
-	fdsize++;
-
-	if (dt > 0.)
-	  {
-	     tval.tv_sec = (long)dt / 1000;
-	     tval.tv_usec = ((long)dt - tval.tv_sec * 1000) * 1000;
-	     count = select(fdsize, &fdset, NULL, NULL, &tval);
-	  }
+#if USE_EPOLL
+	if (ep_fd >= 0)
+	   _EventsWaitEpoll(dt, dtl);
 	else
-	  {
-	     count = select(fdsize, &fdset, NULL, NULL, NULL);
-	  }
-
-	if (EDebug(EDBUG_TYPE_EVENTS))
-	   Eprintf("%s: count=%d xfd=%d:%d dtl=%.6lf dt=%.6lf\n", __func__,
-		   count, pfds[0].fd, FD_ISSET(pfds[0].fd, &fdset),
-		   dtl * 1e-3, dt * 1e-3);
-
-	if (count <= 0)
-	   continue;		/* Timeout (or error) */
-
-	/* Excluding X fd */
-	for (i = 1; i < nfds; i++)
-	  {
-	     fd = pfds[i].fd;
-	     if ((fd >= 0) && (FD_ISSET(fd, &fdset)))
-	       {
-		  if (EDebug(EDBUG_TYPE_EVENTS) > 1)
-		     Eprintf("Event fd %d\n", i);
-		  pfds[i].handler();
-	       }
-	  }
+#endif
+	   _EventsWaitSelect(dt, dtl);
      }
 }
 
@@ -50,6 +50,7 @@ void                EventFdUnregister(EventFdDesc * efd);
 
 int                 EventsUpdateXY(int *px, int *py);
 void                EventsBlock(int mode);
+void                EventsCompressStats(int reset);
 
 void                EventsRandrScreenChange(XEvent * xev);
 
@@ -426,6 +426,7 @@ EwinDestroy(EWin * ewin)
    Efree(lst);
 
    EwinCleanup(ewin);
+   EwinHashDel(ewin);
    EobjListOrderDel(&ewin->o);
    EobjListFocusDel(&ewin->o);
    EoFini(ewin);
@@ -441,7 +442,7 @@ EwinDestroy(EWin * ewin)
    Efree(ewin->ewmh.wm_icon);
    Efree(ewin->bits);
    Efree(ewin->session_id);
-   PmapMaskFree(&ewin->mini_pmm);
+   EwinMinisFree(ewin);
    GroupsEwinRemove(ewin);
 
    Efree(ewin);
@@ -779,6 +780,7 @@ AddToFamily(EWin * ewin, EX_Window xwin, XWindowAttributes * pxwa, int startup)
    EwinGetHints(ewin);
    WindowMatchEwinOps(ewin);	/* Window matches */
    EwinManage(ewin);
+   EwinHashAdd(ewin);
    EwinConfigure(ewin);
 
    if (startup)
@@ -1068,6 +1070,7 @@ AddInternalToFamily(Win win, const char *bname, int type,
    EwinGetAttributes(ewin, win, NoXID, NULL);
    WindowMatchEwinOps(ewin);	/* Window matches */
    EwinManage(ewin);
+   EwinHashAdd(ewin);
 
    ewin->data = ptr;
    ewin->ops = ops;
@@ -2653,6 +2656,110 @@ EwinHandleEventsRoot(Win win __UNUSED__, XEvent * ev, void *prm __UNUSED__)
      }
 }
 
+/*
+ * Mini (thumbnail) cache
+ *
+ * Scaled down window contents shared by the pagers, hiwin and iconbox
+ * snapshots, so the same content is only scaled once per size.
+ * The few most recently used sizes are kept per window.
+ * gen is the EObj serial (bumped by damage) at the time of rendering.
+ */
+#define EWIN_MINIS_MAX 4
+
+EwinMini           *
+EwinMiniFind(EWin * ewin, int w, int h)
+{
+   EwinMini           *em, *prev;
+
+   for (prev = NULL, em = ewin->minis; em; prev = em, em = em->next)
+     {
+	if (em->pmm.w != w || em->pmm.h != h)
+	   continue;
+	if (prev)
+	  {
+	     /* Move to front */
+	     prev->next = em->next;
+	     em->next = ewin->minis;
+	     ewin->minis = em;
+	  }
+	return em;
+     }
+
+   return NULL;
+}
+
+/* Like EwinMiniFind() but create if not found. New ones are not valid. */
+EwinMini           *
+EwinMiniGet(EWin * ewin, Win win, int w, int h)
+{
+   EwinMini           *em, *prev;
+   int                 num;
+
+   em = EwinMiniFind(ewin, w, h);
+   if (em && em->pmm.depth == WinGetDepth(win))
+      return em;
+
+   if (!em)
+     {
+	/* Reuse the least recently used one if at max */
+	for (num = 0, prev = NULL, em = ewin->minis; em && em->next;
+	     num++, prev = em, em = em->next)
+	   ;
+	if (em && num + 1 >= EWIN_MINIS_MAX)
+	  {
+	     if (prev)
+		prev->next = NULL;
+	     else
+		ewin->minis = NULL;
+	  }
+	else
+	  {
+	     em = ECALLOC(EwinMini, 1);
+	     if (!em)
+		return NULL;
+	  }
+	em->next = ewin->minis;
+	ewin->minis = em;
+     }
+
+   PmapMaskFree(&em->pmm);
+   PmapMaskInit(&em->pmm, win, w, h);
+   em->valid = 0;
+
+   return em;
+}
+
+/* Get the largest valid one, e.g. for zooming */
+EwinMini           *
+EwinMiniGetBest(EWin * ewin)
+{
+   EwinMini           *em, *best;
+
+   best = NULL;
+   for (em = ewin->minis; em; em = em->next)
+     {
+	if (!em->valid || em->pmm.pmap == NoXID)
+	   continue;
+	if (!best || em->pmm.w * em->pmm.h > best->pmm.w * best->pmm.h)
+	   best = em;
+     }
+
+   return best;
+}
+
+void
+EwinMinisFree(EWin * ewin)
+{
+   EwinMini           *em;
+
+   while ((em = ewin->minis))
+     {
+	ewin->minis = em->next;
+	PmapMaskFree(&em->pmm);
+	Efree(em);
+     }
+}
+
 static void
 EwinsInit(void)
 {
@@ -64,6 +64,15 @@ typedef struct {
    void                (*Close) (EWin * ewin);
 } EWinOps;
 
+typedef struct _ewinmini EwinMini;
+
+struct _ewinmini {
+   EwinMini           *next;
+   PmapMask            pmm;
+   unsigned int        gen;	/* EObj serial of content */
+   char                valid;
+};
+
 struct _ewin {
    EObj                o;
    char                type;
@@ -249,7 +258,7 @@ struct _ewin {
    Group             **groups;
    int                 area_x, area_y;
    char               *session_id;
-   PmapMask            mini_pmm;
+   EwinMini           *minis;	/* Thumbnails, most recently used first */
 
    int                 shape_x, shape_y, shape_w, shape_h;
    int                 req_x, req_y;
@@ -275,6 +284,13 @@ struct _ewin {
    Timer              *timer;	/* Autoshade timer */
 
    void               *shape_data;	/* Shape drawing data hook */
+
+   struct {			/* Finder hash links (finders.c) */
+      EWin               *next_xwin;
+      EWin               *next_ptr;
+      EX_Window           xwin;
+      char                added;
+   } hash;
 };
 
 #define EWIN_STATE_NEW          0	/* New */
@@ -402,6 +418,11 @@ void                EwinWarpTo(EWin * ewin, int force);
 EWin              **EwinListTransients(const EWin * ewin, int *num, int group);
 EWin              **EwinListTransientFor(const EWin * ewin, int *num);
 
+EwinMini           *EwinMiniFind(EWin * ewin, int w, int h);
+EwinMini           *EwinMiniGet(EWin * ewin, Win win, int w, int h);
+EwinMini           *EwinMiniGetBest(EWin * ewin);
+void                EwinMinisFree(EWin * ewin);
+
 void                EwinsManage(void);
 void                EwinsSetFree(void);
 void                EwinsShowDesktop(int on);
@@ -457,6 +478,8 @@ void                EwinOpMoveToDesk(EWin * ewin, int source, Desk * dsk,
 void                EwinOpFullscreen(EWin * ewin, int source, int on);
 
 /* finders.c */
+void                EwinHashAdd(EWin * ewin);
+void                EwinHashDel(EWin * ewin);
 EWin               *EwinFindByPtr(const EWin * ewin);
 EWin               *EwinFindByClient(EX_Window win);
 EWin              **EwinsFindByExpr(const char *match, int *pnum, int *pflags);
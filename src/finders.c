@@ -31,17 +31,123 @@
 #include "groups.h"
 #include "util.h"
 
+/*
+ * Client window and pointer lookups are done through hash tables with
+ * the chain links in the EWin.
+ * Ewins are added when managed and removed when destroyed.
+ */
+#define EWIN_HASH_MIN_BITS 6
+
+static struct {
+   EWin              **by_xwin;
+   EWin              **by_ptr;
+   unsigned int        bits;
+   unsigned int        num;
+} ewin_hash;
+
+#define EWIN_HASH(val, bits) \
+   ((unsigned int)((unsigned int)(val) * 2654435761u) >> (32 - (bits)))
+#define EWIN_HASH_XWIN(xwin) EWIN_HASH(xwin, ewin_hash.bits)
+#define EWIN_HASH_PTR(ptr) EWIN_HASH((unsigned long)(ptr) >> 4, ewin_hash.bits)
+
+static void
+_EwinHashInsert(EWin * ewin)
+{
+   unsigned int        i;
+
+   i = EWIN_HASH_XWIN(ewin->hash.xwin);
+   ewin->hash.next_xwin = ewin_hash.by_xwin[i];
+   ewin_hash.by_xwin[i] = ewin;
+
+   i = EWIN_HASH_PTR(ewin);
+   ewin->hash.next_ptr = ewin_hash.by_ptr[i];
+   ewin_hash.by_ptr[i] = ewin;
+}
+
+static void
+_EwinHashResize(unsigned int bits)
+{
+   EWin              **by_ptr, *ewin, *next;
+   unsigned int        i, size;
+
+   size = 1U << ewin_hash.bits;
+   by_ptr = ewin_hash.by_ptr;
+   Efree(ewin_hash.by_xwin);
+
+   ewin_hash.bits = bits;
+   ewin_hash.by_xwin = ECALLOC(EWin *, 1U << bits);
+   ewin_hash.by_ptr = ECALLOC(EWin *, 1U << bits);
+
+   for (i = 0; by_ptr && i < size; i++)
+     {
+	for (ewin = by_ptr[i]; ewin; ewin = next)
+	  {
+	     next = ewin->hash.next_ptr;
+	     _EwinHashInsert(ewin);
+	  }
+     }
+   Efree(by_ptr);
+}
+
+void
+EwinHashDel(EWin * ewin)
+{
+   EWin              **pp;
+
+   if (!ewin->hash.added)
+      return;
+
+   for (pp = &ewin_hash.by_xwin[EWIN_HASH_XWIN(ewin->hash.xwin)]; *pp;
+	pp = &(*pp)->hash.next_xwin)
+     {
+	if (*pp != ewin)
+	   continue;
+	*pp = ewin->hash.next_xwin;
+	break;
+     }
+
+   for (pp = &ewin_hash.by_ptr[EWIN_HASH_PTR(ewin)]; *pp;
+	pp = &(*pp)->hash.next_ptr)
+     {
+	if (*pp != ewin)
+	   continue;
+	*pp = ewin->hash.next_ptr;
+	break;
+     }
+
+   ewin->hash.added = 0;
+   ewin_hash.num--;
+}
+
+void
+EwinHashAdd(EWin * ewin)
+{
+   /* Re-add if the client window has changed */
+   EwinHashDel(ewin);
+
+   if (!ewin_hash.by_xwin)
+      _EwinHashResize(EWIN_HASH_MIN_BITS);
+   else if (ewin_hash.num >= (1U << ewin_hash.bits))
+      _EwinHashResize(ewin_hash.bits + 1);
+
+   ewin->hash.xwin = EwinGetClientXwin(ewin);
+   ewin->hash.added = 1;
+   ewin_hash.num++;
+   _EwinHashInsert(ewin);
+}
+
 EWin               *
 EwinFindByPtr(const EWin * ewin)
 {
-   EWin               *const *ewins;
-   int                 i, num;
+   EWin               *e;
 
-   ewins = EwinListGetAll(&num);
-   for (i = 0; i < num; i++)
+   if (!ewin_hash.by_ptr)
+      return NULL;
+
+   for (e = ewin_hash.by_ptr[EWIN_HASH_PTR(ewin)]; e; e = e->hash.next_ptr)
      {
-	if (ewin == ewins[i])
-	   return ewins[i];
+	if (e == ewin)
+	   return e;
      }
    return NULL;
 }
@@ -49,14 +155,15 @@ EwinFindByPtr(const EWin * ewin)
 EWin               *
 EwinFindByClient(EX_Window win)
 {
-   EWin               *const *ewins;
-   int                 i, num;
+   EWin               *e;
 
-   ewins = EwinListGetAll(&num);
-   for (i = 0; i < num; i++)
+   if (!ewin_hash.by_xwin)
+      return NULL;
+
+   for (e = ewin_hash.by_xwin[EWIN_HASH_XWIN(win)]; e; e = e->hash.next_xwin)
      {
-	if (win == EwinGetClientXwin(ewins[i]))
-	   return ewins[i];
+	if (e->hash.xwin == win)
+	   return e;
      }
    return NULL;
 }
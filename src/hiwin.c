@@ -76,6 +76,7 @@ HiwinRenderImageInit(Hiwin * phi)
 {
    EWin               *ewin = phi->ewin;
    EX_Pixmap           pmap;
+   EwinMini           *em;
 
    pmap = EoGetPixmap(ewin);
    if (pmap)
@@ -88,11 +89,10 @@ HiwinRenderImageInit(Hiwin * phi)
      {
 	phi->im = EobjGetImage(EoObj(ewin), EoGetXwin(ewin));
      }
-   else
+   else if ((em = EwinMiniGetBest(ewin)))
      {
-	phi->im =
-	   EImageGrabDrawable(ewin->mini_pmm.pmap, ewin->mini_pmm.mask, 0, 0,
-			      ewin->mini_pmm.w, ewin->mini_pmm.h, 0);
+	phi->im = EImageGrabDrawable(em->pmm.pmap, em->pmm.mask, 0, 0,
+				     em->pmm.w, em->pmm.h, 0);
      }
 
    ESetWindowBackgroundPixmap(EoGetWin(phi), NoXID, 0);
@@ -362,7 +362,7 @@ HiwinShow(Hiwin * phi, EWin * ewin, int zoom, int confine)
    if (!ewin)
       return;
 
-   if (ewin->mini_pmm.pmap)
+   if (EwinMiniGetBest(ewin))
       pz = &HiwinRenderImage;
    else if (hiwin_ic)
       pz = &HiwinRenderIclass;
@@ -72,6 +72,10 @@ static              LIST_HEAD(iclass_list);
 
 static ImageClass  *ImageclassGetFallback(void);
 
+#ifdef ENABLE_TRANSPARENCY
+static void         pt_bg_cache_free(void);
+#endif
+
 #ifdef ENABLE_THEME_TRANSPARENCY
 
 static EImageColorModifier *icm = NULL;
@@ -145,11 +149,150 @@ TransparencySet(int transparency)
 	/* Hack to get tiled backgrounds regenerated at full size */
 	BackgroundsInvalidate(1);
      }
+#ifdef ENABLE_TRANSPARENCY
+   if (transparency == 0)
+      pt_bg_cache_free();
+#endif
    ModulesSignal(ESIGNAL_THEME_TRANS_CHANGE, NULL);
 }
 
 #endif /* ENABLE_THEME_TRANSPARENCY */
 
+/*
+ * Rendered imagestate pixmap cache
+ *
+ * Opaque renderings depend only on imagestate, size and depth, so e.g.
+ * the titlebar parts of equally sized windows can share them.
+ * Entries are kept in LRU order (most recent first) and the least
+ * recently used unreferenced ones are dropped when the estimated pixmap
+ * memory exceeds misc.testing.pixmap_cache_size (kB).
+ */
+typedef struct {
+   dlist_t             list;
+   ImageState         *is;
+   unsigned short      w, h;	/* Requested size */
+   char                depth;
+   unsigned int        ref_count;
+   unsigned int        size;	/* Estimated pixmap memory, bytes */
+   PmapMask            pmm;
+} IsPmapCacheEntry;
+
+static              LIST_HEAD(is_pmap_cache);
+
+static struct {
+   unsigned int        num, size;
+   unsigned int        hits, misses, evictions;
+} is_pmap_cache_stats;
+
+static void
+IsPmapCacheEntryFree(IsPmapCacheEntry * pce)
+{
+   LIST_REMOVE(IsPmapCacheEntry, &is_pmap_cache, pce);
+   is_pmap_cache_stats.num--;
+   is_pmap_cache_stats.size -= pce->size;
+   PmapMaskFree(&pce->pmm);
+   Efree(pce);
+}
+
+/* Drop unreferenced entries, least recently used first, until size fits */
+static void
+IsPmapCacheTrim(unsigned int size_max)
+{
+   IsPmapCacheEntry   *pce, *tmp;
+
+   for (pce = (IsPmapCacheEntry *) is_pmap_cache.prev;
+	&pce->list != &is_pmap_cache && is_pmap_cache_stats.size > size_max;
+	pce = tmp)
+     {
+	tmp = (IsPmapCacheEntry *) pce->list.prev;
+	if (pce->ref_count > 0)
+	   continue;
+	IsPmapCacheEntryFree(pce);
+	is_pmap_cache_stats.evictions++;
+     }
+}
+
+static IsPmapCacheEntry *
+IsPmapCacheGet(ImageState * is, Win win, int w, int h)
+{
+   IsPmapCacheEntry   *pce;
+
+   LIST_FOR_EACH(IsPmapCacheEntry, &is_pmap_cache, pce)
+   {
+      if (pce->is != is || pce->w != w || pce->h != h ||
+	  pce->depth != WinGetDepth(win))
+	 continue;
+
+      /* Move to front */
+      LIST_REMOVE(IsPmapCacheEntry, &is_pmap_cache, pce);
+      LIST_PREPEND(IsPmapCacheEntry, &is_pmap_cache, pce);
+      pce->ref_count++;
+      is_pmap_cache_stats.hits++;
+      return pce;
+   }
+
+   is_pmap_cache_stats.misses++;
+   return NULL;
+}
+
+/* Add rendered pixmaps (taking ownership) as referenced entry */
+static IsPmapCacheEntry *
+IsPmapCacheAdd(ImageState * is, Win win, int w, int h, PmapMask * pmm)
+{
+   IsPmapCacheEntry   *pce;
+   unsigned int        size, size_max;
+   int                 depth;
+
+   depth = WinGetDepth(win);
+   size = pmm->w * pmm->h * ((depth > 16) ? 4 : (depth > 8) ? 2 : 1);
+   if (pmm->mask)
+      size += pmm->w * pmm->h / 8;
+
+   size_max = 1024 * Conf.testing.pixmap_cache_size;
+   if (size > size_max / 4)
+      return NULL;		/* Too big to be worth it */
+
+   IsPmapCacheTrim(size_max - size);
+
+   pce = ECALLOC(IsPmapCacheEntry, 1);
+   if (!pce)
+      return NULL;
+
+   pce->is = is;
+   pce->w = w;
+   pce->h = h;
+   pce->depth = depth;
+   pce->ref_count = 1;
+   pce->size = size;
+   pce->pmm = *pmm;
+   LIST_PREPEND(IsPmapCacheEntry, &is_pmap_cache, pce);
+   is_pmap_cache_stats.num++;
+   is_pmap_cache_stats.size += size;
+
+   return pce;
+}
+
+static void
+IsPmapCacheRelease(IsPmapCacheEntry * pce)
+{
+   if (pce->ref_count > 0)
+      pce->ref_count--;
+}
+
+/* Drop all entries of imagestate (all if NULL) */
+static void
+IsPmapCacheFlush(ImageState * is)
+{
+   IsPmapCacheEntry   *pce, *tmp;
+
+   LIST_FOR_EACH_SAFE(IsPmapCacheEntry, &is_pmap_cache, pce, tmp)
+   {
+      if (is && pce->is != is)
+	 continue;
+      IsPmapCacheEntryFree(pce);
+   }
+}
+
 EImage             *
 ThemeImageLoad(const char *file)
 {
@@ -231,6 +374,8 @@ ImagestateDestroy(ImageState * is)
    if (!is)
       return;
 
+   IsPmapCacheFlush(is);
+
    Efree(is->im_file);
    Efree(is->real_file);
 
@@ -779,15 +924,68 @@ pt_type_to_flags(int image_type)
    return flags;
 }
 
+/*
+ * Client side copy of a desk background pixmap, so transparent parts can be
+ * cropped from it instead of reading back from the server for every part on
+ * every redraw. It is keyed by background pixmap and sequence number, so it
+ * survives switching between desks sharing a background, and is refreshed
+ * when the background changes. Grabbing a new copy is deferred while
+ * switching desks, parts are read back individually meanwhile. Dropped on
+ * screen resize.
+ */
+typedef struct {
+   EX_Pixmap           pmap;
+   unsigned int        seq_no;
+   int                 w, h;
+   EImage             *im;
+} PtBgCache;
+
+static PtBgCache    pt_bg_cache;
+static char         pt_bg_cache_defer;
+
+static void
+pt_bg_cache_free(void)
+{
+   if (pt_bg_cache.im)
+      EImageFree(pt_bg_cache.im);
+   memset(&pt_bg_cache, 0, sizeof(pt_bg_cache));
+}
+
+static PtBgCache   *
+pt_bg_cache_get(EX_Pixmap pmap, unsigned int seq_no, int defer)
+{
+   PtBgCache          *pbc = &pt_bg_cache;
+
+   if (pbc->im && pbc->pmap == pmap && pbc->seq_no == seq_no)
+      return pbc;
+
+   if (defer)
+      return NULL;
+
+   pt_bg_cache_free();
+   pbc->pmap = pmap;
+   pbc->seq_no = seq_no;
+
+   if (!EXGetGeometry(pmap, NULL, NULL, NULL, &pbc->w, &pbc->h, NULL, NULL))
+      return NULL;
+   pbc->im = EImageGrabDrawable(pmap, NoXID, 0, 0, pbc->w, pbc->h,
+				!EServerIsGrabbed());
+
+   return (pbc->im) ? pbc : NULL;
+}
+
 static EImage      *
 pt_get_bg_image(Win win, int w, int h, int use_root)
 {
    EImage             *ii = NULL;
    Win                 cr;
    EX_Drawable         bg;
+   PtBgCache          *pbc;
+   Desk               *dsk;
    int                 xx, yy;
 
-   bg = DeskGetBackgroundPixmap(DesksGetCurrent());
+   dsk = DesksGetCurrent();
+   bg = DeskGetBackgroundPixmap(dsk);
    if (use_root || bg == NoXID)
      {
 	cr = VROOT;
@@ -795,7 +993,7 @@ pt_get_bg_image(Win win, int w, int h, int use_root)
      }
    else
      {
-	cr = EoGetWin(DesksGetCurrent());
+	cr = EoGetWin(dsk);
      }
    ETranslateCoordinates(win, cr, 0, 0, &xx, &yy, NULL);
 #if 0
@@ -803,6 +1001,12 @@ pt_get_bg_image(Win win, int w, int h, int use_root)
 #endif
    if (xx < WinGetW(VROOT) && yy < WinGetH(VROOT) && xx + w >= 0 && yy + h >= 0)
      {
+	/* Crop from the client side copy if entirely inside */
+	pbc = (cr != VROOT) ?
+	   pt_bg_cache_get(bg, dsk->bg.seq_no, pt_bg_cache_defer) : NULL;
+	if (pbc && xx >= 0 && yy >= 0 && xx + w <= pbc->w && yy + h <= pbc->h)
+	   return EImageCreateScaled(pbc->im, xx, yy, w, h, w, h);
+
 	/* Create the background base image */
 	ii = EImageGrabDrawable(bg, NoXID, xx, yy, w, h, !EServerIsGrabbed());
      }
@@ -810,6 +1014,85 @@ pt_get_bg_image(Win win, int w, int h, int use_root)
    return ii;
 }
 
+#if ENABLE_BENCHMARKS
+/* Time getting part backgrounds only, not whole part or window redraws */
+static void
+pt_bench(int n)
+{
+   static const int    sizes[][2] = { {300, 20}, {8, 600}, {600, 400} };
+   Desk               *dsk = DesksGetCurrent();
+   EX_Pixmap           bg, pmap;
+   PtBgCache          *pbc;
+   EImage             *im;
+   unsigned int        t0, t1, t2, t3;
+   int                 i, j, w, h, x, y, sw, sh;
+
+   bg = DeskGetBackgroundPixmap(dsk);
+   if (bg == NoXID)
+     {
+	IpcPrintf("No desk background pixmap\n");
+	return;
+     }
+   if (n <= 0)
+      n = 100;
+
+   t0 = GetTimeUs();
+   pbc = pt_bg_cache_get(bg, dsk->bg.seq_no, 0);
+   t1 = GetTimeUs();
+   if (!pbc)
+      return;
+   IpcPrintf("Background %dx%d cached in %.3f ms\n", pbc->w, pbc->h,
+	     1e-3 * (t1 - t0));
+
+   /* Part sized crops at varying positions */
+   for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); j++)
+     {
+	w = sizes[j][0];
+	h = sizes[j][1];
+	sw = pbc->w - w;
+	sh = pbc->h - h;
+	if (sw <= 0 || sh <= 0)
+	   continue;
+
+	pmap = ECreatePixmap(VROOT, w, h, 0);
+
+	t0 = GetTimeUs();
+	for (i = 0; i < n; i++)
+	  {
+	     x = (i * 37) % sw;
+	     y = (i * 53) % sh;
+	     im = EImageGrabDrawable(bg, NoXID, x, y, w, h, 1);
+	     EImageFree(im);
+	  }
+	t1 = GetTimeUs();
+	for (i = 0; i < n; i++)
+	  {
+	     x = (i * 37) % sw;
+	     y = (i * 53) % sh;
+	     im = EImageCreateScaled(pbc->im, x, y, w, h, w, h);
+	     EImageFree(im);
+	  }
+	t2 = GetTimeUs();
+	for (i = 0; i < n; i++)
+	  {
+	     x = (i * 37) % sw;
+	     y = (i * 53) % sh;
+	     im = EImageCreateScaled(pbc->im, x, y, w, h, w, h);
+	     EImageRenderOnDrawable(im, VROOT, pmap, 0, 0, 0, w, h);
+	     EImageFree(im);
+	  }
+	ESync(0);
+	t3 = GetTimeUs();
+
+	EFreePixmap(pmap);
+
+	IpcPrintf("%4dx%-4d  readback %8.3f ms  cached %8.3f ms"
+		  "  cached+render %8.3f ms\n", w, h, 1e-3 * (t1 - t0) / n,
+		  1e-3 * (t2 - t1) / n, 1e-3 * (t3 - t2) / n);
+     }
+}
+#endif /* ENABLE_BENCHMARKS */
+
 #endif
 
 EImage             *
@@ -1111,12 +1394,26 @@ ImagestateDrawNoImg(ImageState * is, EX_Drawable draw, int x, int y, int w,
       ImagestateDrawBevel(is, draw, x, y, w, h);
 }
 
+/* Is the rendering of imagestate independent of what is behind it? */
+static int
+ImagestatePmapCacheable(const ImageState * is, int image_type __UNUSED__)
+{
+   if (Conf.testing.pixmap_cache_size <= 0)
+      return 0;
+#ifdef ENABLE_TRANSPARENCY
+   if (is->transparent || pt_type_to_flags(image_type) != ICLASS_ATTR_OPAQUE)
+      return 0;
+#endif
+   return 1;
+}
+
 void
 ITApply(Win win, ImageClass * ic, ImageState * is,
 	int state, int active, int sticky, int image_type,
 	TextClass * tc, TextState * ts, const char *text, int flags)
 {
    int                 w, h;
+   IsPmapCacheEntry   *pce;
 
    if (!win || !ic)
       return;
@@ -1137,16 +1434,30 @@ ITApply(Win win, ImageClass * ic, ImageState * is,
 	   ts = TextclassGetTextState(tc, state, active, sticky);
      }
 
-   if (!is->im)
+   pce = NULL;
+   if (ImagestatePmapCacheable(is, image_type))
+      pce = IsPmapCacheGet(is, win, w, h);
+
+   if (!pce && !is->im)
       ImagestateRealize(is);
 
    /* Imlib2 will not render pixmaps with dimensions > 8192 */
-   if (is->im && w <= 8192 && h <= 8192)
+   if (pce || (is->im && w <= 8192 && h <= 8192))
      {
 	PmapMask            pmm;
 
-	ImagestateMakePmapMask(is, win, &pmm, IC_FLAG_MAKE_MASK, w, h,
-			       image_type);
+	if (pce)
+	  {
+	     pmm = pce->pmm;
+	  }
+	else
+	  {
+	     ImagestateMakePmapMask(is, win, &pmm, IC_FLAG_MAKE_MASK, w, h,
+				    image_type);
+	     if (pmm.pmap && pmm.type != 0 &&
+		 ImagestatePmapCacheable(is, image_type))
+		pce = IsPmapCacheAdd(is, win, w, h, &pmm);
+	  }
 
 	if (pmm.pmap)
 	  {
@@ -1181,9 +1492,12 @@ ITApply(Win win, ImageClass * ic, ImageState * is,
 		EShapeSetMaskTiled(win, 0, 0, pmm.mask, w, h);
 	  }
 
-	PmapMaskFree(&pmm);
+	if (pce)
+	   IsPmapCacheRelease(pce);
+	else
+	   PmapMaskFree(&pmm);
 
-	if ((is->unloadable) || (Conf.memory_paranoia))
+	if (is->im && ((is->unloadable) || (Conf.memory_paranoia)))
 	  {
 	     EImageFree(is->im);
 	     is->im = NULL;
@@ -1385,6 +1699,27 @@ ImageclassGetBlack(void)
  * Imageclass Module
  */
 
+#ifdef ENABLE_TRANSPARENCY
+static void
+ImageclassSighan(int sig, void *prm __UNUSED__)
+{
+   switch (sig)
+     {
+     case ESIGNAL_DESK_SWITCH_START:
+	pt_bg_cache_defer = 1;
+	break;
+     case ESIGNAL_DESK_SWITCH_DONE:
+	pt_bg_cache_defer = 0;
+	break;
+     case ESIGNAL_DESK_RESIZE:
+	pt_bg_cache_free();
+	break;
+     }
+}
+#else
+#define ImageclassSighan NULL
+#endif
+
 static void
 ImageclassIpc(const char *params)
 {
@@ -1412,6 +1747,26 @@ ImageclassIpc(const char *params)
 	return;
      }
 
+#if defined(ENABLE_TRANSPARENCY) && ENABLE_BENCHMARKS
+   if (!strcmp(param1, "ptbench"))
+     {
+	pt_bench(atoi(param2));
+	return;
+     }
+#endif
+
+   if (!strcmp(param1, "pmap_cache"))
+     {
+	if (!strcmp(param2, "flush"))
+	   IsPmapCacheFlush(NULL);
+	IpcPrintf("Pixmap cache: %u entries, %u/%d kB, hits %u, misses %u,"
+		  " evictions %u\n", is_pmap_cache_stats.num,
+		  (is_pmap_cache_stats.size + 1023) / 1024,
+		  Conf.testing.pixmap_cache_size, is_pmap_cache_stats.hits,
+		  is_pmap_cache_stats.misses, is_pmap_cache_stats.evictions);
+	return;
+     }
+
    if (!param1[0])
      {
 	IpcPrintf("ImageClass not specified\n");
@@ -1542,7 +1897,12 @@ static const IpcItem ImageclassIpcArray[] = {
     ImageclassIpc,
     "imageclass", "ic",
     "List imageclasses, apply an imageclass",
-    NULL}
+    "  imageclass list                      List imageclasses\n"
+    "  imageclass pmap_cache [flush]        Show/flush rendered pixmap cache\n"
+#if defined(ENABLE_TRANSPARENCY) && ENABLE_BENCHMARKS
+    "  imageclass ptbench [n]               Time transparent part backgrounds\n"
+#endif
+    "  imageclass <name> <operation> ...    Operate on imageclass\n"}
    ,
 };
 #define N_IPC_FUNCS (sizeof(ImageclassIpcArray)/sizeof(IpcItem))
@@ -1554,7 +1914,7 @@ extern const EModule ModImageclass;
 
 const EModule       ModImageclass = {
    "imageclass", "ic",
-   NULL,
+   ImageclassSighan,
    {N_IPC_FUNCS, ImageclassIpcArray}
    ,
    {0, NULL}
@@ -109,6 +109,8 @@ IB_SnapEWin(EWin * ewin, int size)
    int                 was_shaded;
    EImage             *im;
    EX_Drawable         draw;
+   EX_Pixmap           mask;
+   EwinMini           *em;
 
    if (!EoIsShown(ewin))
       return NULL;
@@ -129,11 +131,32 @@ IB_SnapEWin(EWin * ewin, int size)
    IB_IconGetSize(ww, hh, size, 4, &w, &h);
 
    draw = EoGetPixmap(ewin);
-   if (draw != NoXID)
+   mask = (draw != NoXID) ? EWindowGetShapePixmap(EoGetWin(ewin)) : NoXID;
+   em = NULL;
+   if (draw != NoXID && mask == NoXID)
      {
-	EX_Pixmap           mask;
+	/* Scale on the server, through the shared mini cache */
+	em = EwinMiniFind(ewin, w, h);
+	if (!em || !em->valid || em->gen != EoGetSerial(ewin))
+	  {
+	     em = EwinMiniGet(ewin, EoGetWin(ewin), w, h);
+	     if (em)
+	       {
+		  ScaleRect(EoGetWin(ewin), draw, EoGetWin(ewin), em->pmm.pmap,
+			    0, 0, ww, hh, 0, 0, w, h, EIMAGE_ANTI_ALIAS);
+		  em->gen = EoGetSerial(ewin);
+		  em->valid = 1;
+	       }
+	  }
+     }
 
-	mask = EWindowGetShapePixmap(EoGetWin(ewin));
+   if (em)
+     {
+	im = EImageGrabDrawableScaled(EoGetWin(ewin), em->pmm.pmap, NoXID,
+				      0, 0, w, h, w, h, !EServerIsGrabbed(), 0);
+     }
+   else if (draw != NoXID)
+     {
 	im = EImageGrabDrawableScaled(EoGetWin(ewin), draw, mask, 0, 0, ww, hh,
 				      w, h, !EServerIsGrabbed(), 0);
 	if (mask)
@@ -29,8 +29,10 @@
 #include "aclass.h"
 #include "borders.h"		/* FIXME - Should not be here */
 #include "desktops.h"
+#include "eimage.h"
 #include "emodule.h"
 #include "eobj.h"
+#include "events.h"
 #include "ewins.h"
 #include "ewin-ops.h"
 #include "focus.h"
@@ -1046,6 +1048,30 @@ IPC_Debug(const char *params)
 	     IpcPrintf("Ungrab\n");
 	  }
      }
+   else if (!strncmp(param, "compress", 2))
+     {
+	l = 0;
+	sscanf(p, "%1000s %n", param, &l);
+	EventsCompressStats(!strncmp(param, "reset", 2));
+     }
+   else if (!strncmp(param, "xid", 2))
+     {
+	EXidShow();
+#if ENABLE_BENCHMARKS
+	l = 0;
+	sscanf(p, "%d", &l);
+	if (l > 0)
+	   EXidBench(l);
+#endif
+     }
+#if ENABLE_BENCHMARKS
+   else if (!strncmp(param, "scale", 2))
+     {
+	l = 0;
+	sscanf(p, "%d", &l);
+	ScaleBench(l);
+     }
+#endif
    else if (!strncmp(param, "sync", 2))
      {
 	l = 0;
@@ -1631,7 +1657,17 @@ static const IpcItem IPCArray[] = {
     IPC_Debug,
     "debug", NULL,
     "Set debug options",
-    "  debug events <EvNo>:<EvNo>...\n"},
+    "  debug events <EvNo>:<EvNo>...\n"
+    "  debug compress [reset]  Show events dropped by compression\n"
+#if ENABLE_BENCHMARKS
+    "  debug xid [num]         Show window registry, time num dummy windows\n"
+#else
+    "  debug xid               Show window registry\n"
+#endif
+#if ENABLE_BENCHMARKS
+    "  debug scale [num]       Time imlib2 vs render scaling num times\n"
+#endif
+    },
    {
     IPC_Set, "set", NULL, "Set configuration parameter", NULL},
    {
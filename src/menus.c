@@ -1913,7 +1913,8 @@ MenusSighan(int sig, void *prm __UNUSED__)
    switch (sig)
      {
      case ESIGNAL_START:
-	TIMER_ADD_NP(1000 * MENU_UNLOAD_CHECK_INTERVAL, MenusTimeout, NULL);
+	TimerSetSlack(TIMER_ADD_NP(1000 * MENU_UNLOAD_CHECK_INTERVAL,
+				   MenusTimeout, NULL), 10000);
 	break;
 
      case ESIGNAL_AREA_SWITCH_START:
@@ -204,16 +204,23 @@ static const CfgItem MiscCfgItems[] = {
    CFG_ITEM_BOOL(Conf, startup.firsttime, 1),
    CFG_ITEM_BOOL(Conf, startup.animate, 1),
 
+   CFG_ITEM_INT(Conf, timers.idle_delay, 10000),
+   CFG_ITEM_INT(Conf, timers.idle_slack_factor, 4),
+
    CFG_ITEM_BOOL(Conf, testing.argb_internal_objects, 0),
    CFG_ITEM_BOOL(Conf, testing.argb_internal_clients, 0),
    CFG_ITEM_BOOL(Conf, testing.argb_clients, 0),
    CFG_ITEM_BOOL(Conf, testing.argb_clients_inherit_attr, 0),
    CFG_FUNC_INT(Conf, testing.image_cache_size, -1, _CfgImageCacheSize),
+   CFG_ITEM_INT(Conf, testing.pixmap_cache_size, 4096),
    CFG_ITEM_INT(Conf, testing.mask_alpha_threshold, 8),
    CFG_ITEM_BOOL(Conf, testing.enable_startup_id, 1),
-   CFG_ITEM_BOOL(Conf, testing.use_render_for_scaling, 0),
+   CFG_ITEM_BOOL(Conf, testing.use_render_for_scaling, 1),
    CFG_ITEM_BOOL(Conf, testing.bindings_reload, 1),
    CFG_ITEM_HEX(Conf, testing.no_sync_mask, 0),
+#if USE_EPOLL
+   CFG_ITEM_BOOL(Conf, testing.use_epoll, 1),
+#endif
 
    CFG_ITEM_BOOL(Conf, autosave, 1),
    CFG_ITEM_BOOL(Conf, memory_paranoia, 1),
@@ -27,6 +27,9 @@
 #if USE_XRENDER
 #include <X11/extensions/Xrender.h>
 #endif
+#if USE_COMPOSITE
+#include <X11/extensions/Xdamage.h>
+#endif
 
 #include "E.h"
 #include "backgrounds.h"
@@ -34,6 +37,7 @@
 #include "dialog.h"
 #include "ecompmgr.h"
 #include "emodule.h"
+#include "events.h"
 #include "ewins.h"
 #include "focus.h"
 #include "groups.h"
@@ -64,6 +68,9 @@
 #define PAGER_UPD_EWIN_GEOM     0
 #define PAGER_UPD_EWIN_GONE     1
 #define PAGER_UPD_EWIN_DAMAGE   2
+#define PAGER_UPD_SNAP          3
+
+#define PAGER_SNAP_RECTS_MAX   16
 
 #define EwinGetVX(ew) (ew->vx)
 #define EwinGetVY(ew) (ew->vy)
@@ -87,6 +94,12 @@ static struct {
    Idler              *idler;
    char                update_pending;
    char                timer_pending;
+#if USE_COMPOSITE
+   Damage              snap_damage;	/* Root damage (snap mode) */
+   EX_SrvRegion        snap_parts;	/* Root damage fetched from server */
+   EX_Region           snap_rgn;	/* Screen area to snapshot */
+   EX_Region           snap_tmp;
+#endif
 } Mode_pagers;
 
 typedef struct {
@@ -171,13 +184,144 @@ PagerDestroy(Pager * p)
    Efree(p);
 }
 
+#if USE_COMPOSITE
+/*
+ * Damage driven snapshots
+ *
+ * In snap mode, rather than continuously rescanning the screen, only the
+ * damaged screen areas are rescaled into the pager.
+ * Without compositing the damage is tracked on the root window, with
+ * compositing the compositor collects it.
+ * Updates are throttled to scanspeed per second, and nothing at all is
+ * done while the screen is static.
+ */
+static void         PagersRootEvent(Win win, XEvent * ev, void *prm);
+static void         PagersSnapDamaged(void);
+
+static int
+PagersSnapWanted(void)
+{
+   if (!Conf_pagers.enable || Conf_pagers.scanspeed <= 0)
+      return 0;
+   if (LIST_IS_EMPTY(&pager_list))
+      return 0;
+   if (PagersGetMode() != PAGER_MODE_SNAP)
+      return 0;
+   return 1;
+}
+
+static void
+PagersSnapDamageStop(void)
+{
+   if (Mode_pagers.snap_damage == NoXID)
+      return;
+
+   EventCallbackUnregister(VROOT, PagersRootEvent, NULL);
+   XDamageDestroy(disp, Mode_pagers.snap_damage);
+   Mode_pagers.snap_damage = NoXID;
+   ERegionDestroy(Mode_pagers.snap_parts);
+   Mode_pagers.snap_parts = NoXID;
+}
+
+/* Returns 1 if snapshots are damage driven, 0 if scanning is needed */
+static int
+PagersSnapSetup(void)
+{
+   if (!XEXT_AVAILABLE(XEXT_DAMAGE) || !PagersSnapWanted())
+     {
+	PagersSnapDamageStop();
+	ECompMgrDamageTrack(NULL, NULL);
+	return 0;
+     }
+
+   if (!Mode_pagers.snap_rgn)
+     {
+	Mode_pagers.snap_rgn = ECRegionCreate();
+	Mode_pagers.snap_tmp = ECRegionCreate();
+     }
+
+   if (ECompMgrIsActive())
+     {
+	/* The compositor sees all damage, let it collect it for us */
+	PagersSnapDamageStop();
+	ECompMgrDamageTrack(Mode_pagers.snap_rgn, PagersSnapDamaged);
+	return 1;
+     }
+   ECompMgrDamageTrack(NULL, NULL);
+
+   if (Mode_pagers.snap_damage != NoXID)
+      return 1;
+
+   /* One event when the root gets damaged, the damage region is fetched
+    * (and reset) by PagersSnapUpdate() */
+   Mode_pagers.snap_damage = XDamageCreate(disp, WinGetXwin(VROOT),
+					   XDamageReportNonEmpty);
+   Mode_pagers.snap_parts = ERegionCreate();
+   EventCallbackRegister(VROOT, PagersRootEvent, NULL);
+
+   /* Start out with everything */
+   ECRegionSetRect(Mode_pagers.snap_rgn, 0, 0,
+		   WinGetW(VROOT), WinGetH(VROOT));
+   Mode_pagers.update_pending |= 1 << PAGER_UPD_SNAP;
+
+   return 1;
+}
+
+static void
+PagersSnapAdd(int x, int y, int w, int h)
+{
+   if (!Mode_pagers.snap_rgn)
+      return;
+
+   ECRegionSetRect(Mode_pagers.snap_tmp, x, y, w, h);
+   ECRegionUnion(Mode_pagers.snap_rgn, Mode_pagers.snap_tmp);
+   Mode_pagers.update_pending |= 1 << PAGER_UPD_SNAP;
+}
+
+static void
+PagersSnapDamaged(void)
+{
+   Mode_pagers.update_pending |= 1 << PAGER_UPD_SNAP;
+}
+
+static void
+PagersRootEvent(Win win __UNUSED__, XEvent * ev, void *prm __UNUSED__)
+{
+   XDamageNotifyEvent *de = (XDamageNotifyEvent *) ev;
+
+   if (ev->type != EX_EVENT_DAMAGE_NOTIFY ||
+       de->damage != Mode_pagers.snap_damage)
+      return;
+
+   if (!PagersSnapWanted() || ECompMgrIsActive())
+     {
+	/* Stop, or switch to compositor damage */
+	PagersSnapSetup();
+	return;
+     }
+
+   Mode_pagers.update_pending |= 1 << PAGER_UPD_SNAP;
+}
+#endif /* USE_COMPOSITE */
+
 static void
 PagerScanTrig(Pager * p)
 {
+#if USE_COMPOSITE
+   if (PagersSnapSetup())
+     {
+	/* Visibility or mode changed - may be out of date */
+	PagerScanCancel(p);
+	PagersSnapAdd(0, 0, WinGetW(VROOT), WinGetH(VROOT));
+	return;
+     }
+#endif
+
    if (p->scan_timer || Conf_pagers.scanspeed <= 0)
       return;
 
    TIMER_ADD(p->scan_timer, 1000 / Conf_pagers.scanspeed, PagerScanTimeout, p);
+   TimerSetSlack(p->scan_timer, 500 / Conf_pagers.scanspeed);
 }
 
 static void
@@ -263,48 +407,60 @@ static void
 PagerHiwinUpdate(Hiwin * phi, Pager * p __UNUSED__, EWin * ewin)
 {
    EImage             *im;
+   EwinMini           *em;
 
-   if (!EoIsShown(phi) || !ewin->mini_pmm.pmap)
+   em = EwinMiniGetBest(ewin);
+   if (!EoIsShown(phi) || !em)
       return;
 
-   im = EImageGrabDrawable(ewin->mini_pmm.pmap, NoXID, 0, 0,
-			   ewin->mini_pmm.w, ewin->mini_pmm.h, 0);
+   im = EImageGrabDrawable(em->pmm.pmap, NoXID, 0, 0,
+			   em->pmm.w, em->pmm.h, 0);
    EImageRenderOnDrawable(im, EoGetWin(phi), 0, 0, 0, EoGetW(phi), EoGetH(phi));
    EImageDecache(im);
 }
 #endif
 
+static void
+PagerEwinMiniSize(const Pager * p, const EWin * ewin, int *pw, int *ph)
+{
+   int                 w, h;
+
+   w = (EoGetW(ewin) * p->dw) / WinGetW(VROOT);
+   h = (EoGetH(ewin) * p->dh) / WinGetH(VROOT);
+
+   *pw = (w < 1) ? 1 : w;
+   *ph = (h < 1) ? 1 : h;
+}
+
 static void
 PagerEwinUpdateMini(Pager * p, EWin * ewin)
 {
-   int                 w, h, update, use_iclass, serdif;
+   int                 w, h, live, use_iclass, serdif;
    EX_Drawable         draw;
+   EwinMini           *em;
    int                 pager_mode = PagersGetMode();
 
-   w = (EoGetW(ewin) * p->dw) / WinGetW(VROOT);
-   h = (EoGetH(ewin) * p->dh) / WinGetH(VROOT);
+#if USE_COMPOSITE
+   EX_Picture          pict;
+#endif
 
-   if (w < 1)
-      w = 1;
-   if (h < 1)
-      h = 1;
+   PagerEwinMiniSize(p, ewin, &w, &h);
 
    serdif = EoGetSerial(ewin) - p->serial;
 
-   update = 0;
-   if (!ewin->mini_pmm.pmap)
-      update = 1;
-   if (ewin->mini_pmm.w != w || ewin->mini_pmm.h != h)
-      update = 1;
-
-   if (serdif > 0 && ewin->type != EWIN_TYPE_PAGER &&
-       pager_mode == PAGER_MODE_LIVE && Mode.mode == 0)
-      update = 1;
+   live = serdif > 0 && ewin->type != EWIN_TYPE_PAGER &&
+      pager_mode == PAGER_MODE_LIVE && Mode.mode == 0;
    if (serdif > p->serdif)
       p->serdif = serdif;
 
-   if (!update)
-      return;
+   /* The mini may be up to date already if rendered for another pager */
+   em = EwinMiniFind(ewin, w, h);
+   if (em && em->valid && (!live || em->gen == EoGetSerial(ewin)))
+     {
+	if (live)
+	   p->do_update = 1;
+	return;
+     }
 
    Dprintf("%s %#x/%#x wxh=%dx%d ser=%#x/%#x dif=%d: %s\n", __func__,
 	   EwinGetClientXwin(ewin), EoGetXwin(ewin), w, h,
@@ -312,7 +468,24 @@ PagerEwinUpdateMini(Pager * p, EWin * ewin)
 
    p->do_update = 1;
 
-   PmapMaskInit(&ewin->mini_pmm, EoGetWin(ewin), w, h);
+   em = EwinMiniGet(ewin, EoGetWin(ewin), w, h);
+   if (!em)
+      return;
+   em->gen = EoGetSerial(ewin);
+   em->valid = 1;
+
+#if USE_COMPOSITE
+   /* Scale straight from the compositor's window picture */
+   pict = (pager_mode == PAGER_MODE_LIVE) ?
+      ECompMgrWinGetPicture(EoObj(ewin)) : NoXID;
+   if (pict != NoXID)
+     {
+	ScalePicture(pict, EoGetWin(ewin), em->pmm.pmap,
+		     0, 0, EoGetW(ewin), EoGetH(ewin), 0, 0, w, h, HIQ);
+	Dprintf("Scale picture, pmap=%#x\n", em->pmm.pmap);
+	return;
+     }
+#endif
 
    draw = NoXID;
    if (pager_mode != PAGER_MODE_SIMPLE)
@@ -328,15 +501,15 @@ PagerEwinUpdateMini(Pager * p, EWin * ewin)
 	ImageClass         *ic;
 
 	ic = ImageclassFind("PAGER_WIN", 1);
-	ImageclassApplySimple(ic, EoGetWin(ewin), ewin->mini_pmm.pmap,
+	ImageclassApplySimple(ic, EoGetWin(ewin), em->pmm.pmap,
 			      STATE_NORMAL, 0, 0, w, h);
-	Dprintf("Use Iclass, pmap=%#x\n", ewin->mini_pmm.pmap);
+	Dprintf("Use Iclass, pmap=%#x\n", em->pmm.pmap);
      }
    else
      {
-	ScaleRect(EoGetWin(ewin), draw, EoGetWin(ewin), ewin->mini_pmm.pmap,
+	ScaleRect(EoGetWin(ewin), draw, EoGetWin(ewin), em->pmm.pmap,
 		  0, 0, EoGetW(ewin), EoGetH(ewin), 0, 0, w, h, HIQ);
-	Dprintf("Grab scaled, pmap=%#x\n", ewin->mini_pmm.pmap);
+	Dprintf("Grab scaled, pmap=%#x\n", em->pmm.pmap);
      }
 
 #if 0				/* FIXME - Remove? */
@@ -424,6 +597,7 @@ doPagerUpdate(Pager * p)
      {
 	EWin               *ewin;
 	int                 wx, wy, ww, wh;
+	EwinMini           *em;
 
 	ewin = lst[i];
 	if (!EoIsShown(ewin))
@@ -431,34 +605,33 @@ doPagerUpdate(Pager * p)
 
 	wx = (EwinGetVX(ewin) * p->dw) / WinGetW(VROOT);
 	wy = (EwinGetVY(ewin) * p->dh) / WinGetH(VROOT);
-	ww = (EoGetW(ewin) * p->dw) / WinGetW(VROOT);
-	wh = (EoGetH(ewin) * p->dh) / WinGetH(VROOT);
+	PagerEwinMiniSize(p, ewin, &ww, &wh);
 
-	if (ewin->mini_pmm.pmap)
+	em = EwinMiniFind(ewin, ww, wh);
+	if (em && em->valid)
 	  {
 #if USE_COMPOSITE
 	     /*      pmap set by           depth determined by
 	      * PagerEwinUpdateMini()           ewin
 	      * PagerEwinUpdateFromPager()      p->win
 	      */
-	     pict = EPictureCreate(ewin->mini_pmm.depth == WinGetDepth(p->win) ?
-				   p->win : EoGetWin(ewin),
-				   ewin->mini_pmm.pmap);
+	     pict = EPictureCreate(em->pmm.depth == WinGetDepth(p->win) ?
+				   p->win : EoGetWin(ewin), em->pmm.pmap);
 	     alpha = ECompMgrWinGetAlphaPict(EoObj(ewin));
 	     XRenderComposite(disp, PictOpOver, pict, alpha, pager_pict,
 			      0, 0, 0, 0, wx, wy, ww, wh);
 	     EPictureDestroy(pict);
 #else
 #if 0				/* Mask is currently not set anywhere */
-	     if (ewin->mini_pmm.mask)
+	     if (em->pmm.mask)
 	       {
-		  XSetClipMask(disp, gc, ewin->mini_pmm.mask);
+		  XSetClipMask(disp, gc, em->pmm.mask);
 		  XSetClipOrigin(disp, gc, wx, wy);
 	       }
 #endif
-	     EXCopyArea(ewin->mini_pmm.pmap, pmap, 0, 0, ww, wh, wx, wy);
+	     EXCopyArea(em->pmm.pmap, pmap, 0, 0, ww, wh, wx, wy);
 #if 0				/* Mask is currently not set anywhere */
-	     if (ewin->mini_pmm.mask)
+	     if (em->pmm.mask)
 		XSetClipMask(disp, gc, NoXID);
 #endif
 #endif
@@ -821,6 +994,129 @@ PagerCheckUpdate(Pager * p, void *prm __UNUSED__)
    p->do_newbg = p->do_update = 0;
 }
 
+#if USE_COMPOSITE
+typedef struct {
+   XRectangle         *pr;
+   int                 nr;
+} pager_snap_data;
+
+static void
+_PagerSnapRects(Pager * p, void *prm)
+{
+   pager_snap_data    *psd = (pager_snap_data *) prm;
+   EWin               *ewin;
+   EX_Pixmap           pmap;
+   int                 i, cx, cy, sw, sh, x1, y1, x2, y2, sx1, sy1, sx2, sy2;
+
+   ewin = p->ewin;
+   if (!ewin || !EoIsShown(ewin))
+      return;
+   if (ewin->state.visibility == VisibilityFullyObscured)
+      return;
+   if (p->dw <= 0 || p->dh <= 0)
+      return;
+
+   DeskCurrentGetArea(&cx, &cy);
+   sw = WinGetW(VROOT);
+   sh = WinGetH(VROOT);
+   pmap = WinGetPmap(p->win);
+
+   for (i = 0; i < psd->nr; i++)
+     {
+	/* Pager pixels covering the damage, and the screen area they show */
+	x1 = (psd->pr[i].x * p->dw) / sw;
+	y1 = (psd->pr[i].y * p->dh) / sh;
+	x2 = ((psd->pr[i].x + psd->pr[i].width) * p->dw + sw - 1) / sw;
+	y2 = ((psd->pr[i].y + psd->pr[i].height) * p->dh + sh - 1) / sh;
+	if (x1 < 0)
+	   x1 = 0;
+	if (y1 < 0)
+	   y1 = 0;
+	if (x2 > p->dw)
+	   x2 = p->dw;
+	if (y2 > p->dh)
+	   y2 = p->dh;
+	if (x2 <= x1 || y2 <= y1)
+	   continue;
+	sx1 = (x1 * sw) / p->dw;
+	sy1 = (y1 * sh) / p->dh;
+	sx2 = (x2 * sw) / p->dw;
+	sy2 = (y2 * sh) / p->dh;
+
+	ScaleRect(VROOT, WinGetXwin(VROOT), p->win, pmap,
+		  sx1, sy1, sx2 - sx1, sy2 - sy1,
+		  cx * p->dw + x1, cy * p->dh + y1, x2 - x1, y2 - y1, HIQ);
+	EClearArea(p->win, cx * p->dw + x1, cy * p->dh + y1, x2 - x1, y2 - y1);
+     }
+
+   PagerUpdateEwinsFromPager(p);
+}
+
+static void
+_PagerSnapExclude(Pager * p, void *prm __UNUSED__)
+{
+   EWin               *ewin = p->ewin;
+
+   /* Don't snapshot pagers, that would update forever */
+   if (!ewin || !EoIsShown(ewin))
+      return;
+   ECRegionSetRect(Mode_pagers.snap_tmp, EoGetX(ewin), EoGetY(ewin),
+		   EoGetW(ewin), EoGetH(ewin));
+   ECRegionSubtract(Mode_pagers.snap_rgn, Mode_pagers.snap_tmp);
+}
+
+static void
+PagersSnapUpdate(void)
+{
+   pager_snap_data     psd;
+   XRectangle          box;
+
+   if (!Mode_pagers.snap_rgn)
+      return;
+
+   /* Fetch root damage, damage after this point is reported again */
+   if (Mode_pagers.snap_damage != NoXID)
+     {
+	XDamageSubtract(disp, Mode_pagers.snap_damage, NoXID,
+			Mode_pagers.snap_parts);
+	ECRegionFetch(Mode_pagers.snap_tmp, Mode_pagers.snap_parts);
+	ECRegionUnion(Mode_pagers.snap_rgn, Mode_pagers.snap_tmp);
+     }
+
+   if (!PagersSnapSetup())
+     {
+	ECRegionEmpty(Mode_pagers.snap_rgn);
+	return;
+     }
+
+   if (Mode.mode != MODE_NONE)
+     {
+	/* Keep collecting, snapshot when the mode ends */
+	Mode_pagers.update_pending |= 1 << PAGER_UPD_SNAP;
+	return;
+     }
+
+   PagersForeach(NULL, _PagerSnapExclude, NULL);
+
+   psd.pr = ECRegionGetRects(Mode_pagers.snap_rgn, &psd.nr);
+   if (psd.nr > PAGER_SNAP_RECTS_MAX)
+     {
+	ECRegionGetBox(Mode_pagers.snap_rgn, &box);
+	Efree(psd.pr);
+	psd.pr = &box;
+	psd.nr = 1;
+     }
+   ECRegionEmpty(Mode_pagers.snap_rgn);
+
+   Dprintf("%s: %d rects\n", __func__, psd.nr);
+   if (psd.nr > 0)
+      PagersForeach(DesksGetCurrent(), _PagerSnapRects, &psd);
+
+   if (psd.pr != &box)
+      Efree(psd.pr);
+}
+#endif /* USE_COMPOSITE */
+
 static int
 _PagersUpdateTimeout(void *data __UNUSED__)
 {
@@ -839,7 +1135,8 @@ PagersCheckUpdate(void)
    if (!Mode_pagers.update_pending || !Conf_pagers.enable)
       return;
 
-   if (Mode_pagers.update_pending == (1 << PAGER_UPD_EWIN_DAMAGE))
+   if (!(Mode_pagers.update_pending &
+	 ~((1 << PAGER_UPD_EWIN_DAMAGE) | (1 << PAGER_UPD_SNAP))))
      {
 	tms = GetTimeMs();
 	dtms = (Conf_pagers.scanspeed > 0) ? 1000 / Conf_pagers.scanspeed : 100;
@@ -856,6 +1153,15 @@ PagersCheckUpdate(void)
      }
 
    PagersForeach(NULL, PagerCheckUpdate, NULL);
+#if USE_COMPOSITE
+   if (Mode_pagers.update_pending & (1 << PAGER_UPD_SNAP))
+     {
+	/* May leave the snapshot pending */
+	Mode_pagers.update_pending = 0;
+	PagersSnapUpdate();
+	return;
+     }
+#endif
 
    Mode_pagers.update_pending = 0;
 }
@@ -872,30 +1178,24 @@ static void
 PagerEwinUpdateFromPager(Pager * p, EWin * ewin)
 {
    int                 x, y, w, h;
+   EwinMini           *em;
 
    if (!EoIsShown(ewin) || !EwinIsOnScreen(ewin))
       return;
 
    Dprintf("%s %d\n", __func__, p->dsk->num);
 
-   x = EwinGetVX(ewin);
-   y = EwinGetVY(ewin);
-   w = EoGetW(ewin);
-   h = EoGetH(ewin);
-   x = (x * p->dw) / WinGetW(VROOT);
-   y = (y * p->dh) / WinGetH(VROOT);
-   w = (w * p->dw) / WinGetW(VROOT);
-   h = (h * p->dh) / WinGetH(VROOT);
-   if (w <= 0)
-      w = 1;
-   if (h <= 0)
-      h = 1;
-
-   PmapMaskInit(&ewin->mini_pmm, p->win, w, h);
-   if (!ewin->mini_pmm.pmap)
+   x = (EwinGetVX(ewin) * p->dw) / WinGetW(VROOT);
+   y = (EwinGetVY(ewin) * p->dh) / WinGetH(VROOT);
+   PagerEwinMiniSize(p, ewin, &w, &h);
+
+   em = EwinMiniGet(ewin, p->win, w, h);
+   if (!em || !em->pmm.pmap)
       return;
 
-   EXCopyArea(WinGetPmap(p->win), ewin->mini_pmm.pmap, x, y, w, h, 0, 0);
+   EXCopyArea(WinGetPmap(p->win), em->pmm.pmap, x, y, w, h, 0, 0);
+   em->gen = EoGetSerial(ewin);
+   em->valid = 1;
 
 #if 0				/* FIXME - Remove? */
    if (hiwin && ewin == hiwin->ewin)
@@ -937,6 +1237,7 @@ PagersUpdateEwin(EWin * ewin, int why)
      case PAGER_UPD_EWIN_DAMAGE:
 	if (ewin->type == EWIN_TYPE_PAGER)
 	   return;
+	/* Snap mode gets all damage from the compositor */
 	if (PagersGetMode() != PAGER_MODE_LIVE)
 	   return;
 	break;
@@ -1255,7 +1556,7 @@ _EwinsMiniFree(void)
 
    lst = EwinListGetAll(&num);
    for (i = 0; i < num; i++)
-      PmapMaskFree(&(lst[i]->mini_pmm));
+      EwinMinisFree(lst[i]);
 }
 
 static void
@@ -1078,6 +1078,7 @@ SnapshotsSave(void)
 {
    TIMER_DEL(ss_timer);
    TIMER_ADD(ss_timer, 5000, _SnapshotsSaveReal, NULL);
+   TimerSetSlack(ss_timer, 1000);
 }
 
 /* save out all snapped info to disk */
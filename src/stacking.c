@@ -38,9 +38,22 @@ struct _eobjlist {
    int                 nwins;
    EObj              **list;
    char                layered;
-   char                type;
+   char                type;	/* Index into EObj.lpos */
+   unsigned int        version;	/* Bumped on any change */
 };
 
+/*
+ * Filtered copies of the stacking list.
+ * A view is rebuilt when the list version has changed since last time.
+ */
+typedef struct {
+   unsigned int        version;
+   char                valid;
+   int                 num;
+   int                 nalloc;
+   EObj              **lst;
+} EobjListView;
+
 static int          EobjListRaise(EobjList * ewl, EObj * eo, int test);
 static int          EobjListLower(EobjList * ewl, EObj * eo, int test);
 
@@ -71,13 +84,21 @@ EobjListGetIndex(EobjList * ewl, EObj * eo)
 {
    int                 i;
 
-   for (i = 0; i < ewl->nwins; i++)
-      if (ewl->list[i] == eo)
-	 return i;
+   /* The saved position is only valid if the object is actually there */
+   i = eo->lpos[(int)ewl->type];
+   if (i >= 0 && i < ewl->nwins && ewl->list[i] == eo)
+      return i;
 
    return -1;
 }
 
+static void
+EobjListSetPos(EobjList * ewl, int i, int j)
+{
+   for (; i < j; i++)
+      ewl->list[i]->lpos[(int)ewl->type] = i;
+}
+
 static void
 EobjListAdd(EobjList * ewl, EObj * eo, int ontop)
 {
@@ -101,6 +122,7 @@ EobjListAdd(EobjList * ewl, EObj * eo, int ontop)
 	  {
 	     ewl->list[ewl->nwins] = eo;
 	     ewl->nwins++;
+	     EobjListSetPos(ewl, ewl->nwins - 1, ewl->nwins);
 	     EobjListRaise(ewl, eo, 0);
 	  }
 	else
@@ -108,6 +130,7 @@ EobjListAdd(EobjList * ewl, EObj * eo, int ontop)
 	     memmove(ewl->list + 1, ewl->list, ewl->nwins * sizeof(EObj *));
 	     ewl->list[0] = eo;
 	     ewl->nwins++;
+	     EobjListSetPos(ewl, 0, ewl->nwins);
 	     EobjListLower(ewl, eo, 0);
 	  }
 	if (eo->stacked == 0)
@@ -119,13 +142,17 @@ EobjListAdd(EobjList * ewl, EObj * eo, int ontop)
 	  {
 	     memmove(ewl->list + 1, ewl->list, ewl->nwins * sizeof(EObj *));
 	     ewl->list[0] = eo;
+	     ewl->nwins++;
+	     EobjListSetPos(ewl, 0, ewl->nwins);
 	  }
 	else
 	  {
 	     ewl->list[ewl->nwins] = eo;
+	     ewl->nwins++;
+	     EobjListSetPos(ewl, ewl->nwins - 1, ewl->nwins);
 	  }
-	ewl->nwins++;
      }
+   ewl->version++;
 
    EobjListShow("EobjListAdd", ewl);
 }
@@ -145,6 +172,7 @@ EobjListDel(EobjList * ewl, EObj * eo)
    if (n > 0)
      {
 	memmove(ewl->list + i, ewl->list + i + 1, n * sizeof(EObj *));
+	EobjListSetPos(ewl, i, ewl->nwins);
      }
    else if (ewl->nwins <= 0)
      {
@@ -153,6 +181,7 @@ EobjListDel(EobjList * ewl, EObj * eo)
 	ewl->list = NULL;
 	ewl->nalloc = 0;
      }
+   ewl->version++;
 
    EobjListShow("EobjListDel", ewl);
 }
@@ -186,6 +215,8 @@ EobjListLower(EobjList * ewl, EObj * eo, int test)
      {
 	memmove(ewl->list + i, ewl->list + i + 1, n * sizeof(EObj *));
 	ewl->list[j] = eo;
+	EobjListSetPos(ewl, i, j + 1);
+	ewl->version++;
 	if (ewl->layered && eo->stacked > 0)
 	   DeskSetDirtyStack(eo->desk, eo);
      }
@@ -193,6 +224,8 @@ EobjListLower(EobjList * ewl, EObj * eo, int test)
      {
 	memmove(ewl->list + j + 1, ewl->list + j, -n * sizeof(EObj *));
 	ewl->list[j] = eo;
+	EobjListSetPos(ewl, j, i + 1);
+	ewl->version++;
 	if (ewl->layered && eo->stacked > 0)
 	   DeskSetDirtyStack(eo->desk, eo);
      }
@@ -230,6 +263,8 @@ EobjListRaise(EobjList * ewl, EObj * eo, int test)
      {
 	memmove(ewl->list + i, ewl->list + i + 1, n * sizeof(EObj *));
 	ewl->list[j] = eo;
+	EobjListSetPos(ewl, i, j + 1);
+	ewl->version++;
 	if (ewl->layered && eo->stacked > 0)
 	   DeskSetDirtyStack(eo->desk, eo);
      }
@@ -237,6 +272,8 @@ EobjListRaise(EobjList * ewl, EObj * eo, int test)
      {
 	memmove(ewl->list + j + 1, ewl->list + j, -n * sizeof(EObj *));
 	ewl->list[j] = eo;
+	EobjListSetPos(ewl, j, i + 1);
+	ewl->version++;
 	if (ewl->layered && eo->stacked > 0)
 	   DeskSetDirtyStack(eo->desk, eo);
      }
@@ -257,24 +294,87 @@ EobjListFind(const EobjList * ewl, EX_Window win)
    return NULL;
 }
 
-static int
-EobjListTypeCount(const EobjList * ewl, int type)
+/*
+ * The global object/client lists
+ */
+static EobjList     EwinListStack = { "Stack", 0, 0, NULL, 1, 0, 0 };
+static EobjList     EwinListFocus = { "Focus", 0, 0, NULL, 0, 1, 0 };
+static EobjList     EwinListOrder = { "Order", 0, 0, NULL, 0, 2, 0 };
+
+/* Stacking list views: ewins, per desk ewins, per desk objects */
+static EobjListView EwinViewStack;
+static EobjListView *EwinViewDesk = NULL;
+static EobjListView *EobjViewDesk = NULL;
+static int          ViewDeskNum = 0;
+
+static EObj        *const *
+EobjListViewGet(EobjListView * v, int *num, int ewins, int desk, Desk * dsk)
 {
-   int                 i, n;
+   const EobjList     *ewl;
+   int                 i, j;
+   EObj               *eo;
 
-   for (i = n = 0; i < ewl->nwins; i++)
-      if (ewl->list[i]->type == type)
-	 n++;
+   ewl = &EwinListStack;
 
-   return n;
+   if (v->valid && v->version == ewl->version)
+      goto done;
+
+   if (v->nalloc < ewl->nwins)
+     {
+	v->nalloc = (ewl->nwins + 16) & ~0xf;	/* 16 at the time */
+	v->lst = EREALLOC(EObj *, v->lst, v->nalloc);
+     }
+
+   for (i = j = 0; i < ewl->nwins; i++)
+     {
+	eo = ewl->list[i];
+	if (ewins && eo->type != EOBJ_TYPE_EWIN)
+	   continue;
+	if (desk && eo->desk != dsk)
+	   continue;
+
+	v->lst[j++] = eo;
+     }
+   v->num = j;
+   v->version = ewl->version;
+   v->valid = 1;
+
+ done:
+   *num = v->num;
+   return v->lst;
 }
 
-/*
- * The global object/client lists
- */
-static EobjList     EwinListStack = { "Stack", 0, 0, NULL, 1, 0 };
-static EobjList     EwinListFocus = { "Focus", 0, 0, NULL, 0, 1 };
-static EobjList     EwinListOrder = { "Order", 0, 0, NULL, 0, 2 };
+static EobjListView *
+EobjListViewForDesk(int ewins, Desk * dsk)
+{
+   int                 ix, n;
+
+   /* Slot 0 is for objects without desk */
+   ix = (dsk) ? (int)dsk->num + 1 : 0;
+   if (ix >= ViewDeskNum)
+     {
+	n = ix + 1;
+	EwinViewDesk = EREALLOC(EobjListView, EwinViewDesk, n);
+	EobjViewDesk = EREALLOC(EobjListView, EobjViewDesk, n);
+	memset(EwinViewDesk + ViewDeskNum, 0,
+	       (n - ViewDeskNum) * sizeof(EobjListView));
+	memset(EobjViewDesk + ViewDeskNum, 0,
+	       (n - ViewDeskNum) * sizeof(EobjListView));
+	ViewDeskNum = n;
+     }
+
+   return (ewins) ? &EwinViewDesk[ix] : &EobjViewDesk[ix];
+}
+
+void
+EobjSetDesk(EObj * eo, Desk * dsk)
+{
+   if (eo->desk == dsk)
+      return;
+   eo->desk = dsk;
+   /* Per desk views must be rebuilt */
+   EwinListStack.version++;
+}
 
 static EObj        *const *
 EobjListGet(EobjList * ewl, int *num)
@@ -346,31 +446,7 @@ EobjListFocusRaise(EObj * eo)
 EWin               *const *
 EwinListStackGet(int *num)
 {
-   static EWin       **lst = NULL;
-   static int          nalloc = 0;
-   const EobjList     *ewl;
-   int                 i, j, newins;
-   EObj               *eo;
-
-   ewl = &EwinListStack;
-   newins = EobjListTypeCount(ewl, EOBJ_TYPE_EWIN);
-   if (nalloc < newins)
-     {
-	nalloc = (newins + 16) & ~0xf;	/* 16 at the time */
-	lst = EREALLOC(EWin *, lst, nalloc);
-     }
-
-   for (i = j = 0; i < ewl->nwins; i++)
-     {
-	eo = ewl->list[i];
-	if (eo->type != EOBJ_TYPE_EWIN)
-	   continue;
-
-	lst[j++] = (EWin *) eo;
-     }
-
-   *num = j;
-   return lst;
+   return (EWin * const *)EobjListViewGet(&EwinViewStack, num, 1, 0, NULL);
 }
 
 EWin               *const *
@@ -382,63 +458,14 @@ EwinListFocusGet(int *num)
 EWin               *const *
 EwinListGetForDesk(int *num, Desk * dsk)
 {
-   static EWin       **lst = NULL;
-   static int          nalloc = 0;
-   const EobjList     *ewl;
-   int                 i, j, newins;
-   EObj               *eo;
-
-   ewl = &EwinListStack;
-   newins = EobjListTypeCount(ewl, EOBJ_TYPE_EWIN);
-   /* Too many - who cares. */
-   if (nalloc < newins)
-     {
-	nalloc = (newins + 16) & ~0xf;	/* 16 at the time */
-	lst = EREALLOC(EWin *, lst, nalloc);
-     }
-
-   for (i = j = 0; i < ewl->nwins; i++)
-     {
-	eo = ewl->list[i];
-	if (eo->type != EOBJ_TYPE_EWIN || eo->desk != dsk)
-	   continue;
-
-	lst[j++] = (EWin *) eo;
-     }
-
-   *num = j;
-   return lst;
+   return (EWin * const *)EobjListViewGet(EobjListViewForDesk(1, dsk),
+					   num, 1, 1, dsk);
 }
 
 EObj               *const *
 EobjListStackGetForDesk(int *num, Desk * dsk)
 {
-   static EObj       **lst = NULL;
-   static int          nalloc = 0;
-   const EobjList     *ewl;
-   int                 i, j;
-   EObj               *eo;
-
-   ewl = &EwinListStack;
-
-   /* Too many - who cares. */
-   if (nalloc < ewl->nwins)
-     {
-	nalloc = (ewl->nwins + 16) & ~0xf;	/* 16 at the time */
-	lst = EREALLOC(EObj *, lst, nalloc);
-     }
-
-   for (i = j = 0; i < ewl->nwins; i++)
-     {
-	eo = ewl->list[i];
-	if (eo->desk != dsk)
-	   continue;
-
-	lst[j++] = eo;
-     }
-
-   *num = j;
-   return lst;
+   return EobjListViewGet(EobjListViewForDesk(0, dsk), num, 0, 1, dsk);
 }
 
 #if 0				/* Unused */
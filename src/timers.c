@@ -28,10 +28,14 @@
 struct _timer {
    unsigned int        in_time;
    unsigned int        at_time;
-   struct _timer      *next;
+   unsigned int        slack;	/* Allowed delay, for coalescing wakeups */
+   unsigned int        seqn;	/* Orders timers with same at_time */
+   int                 hix;	/* Heap index, -1 if not queued */
+   struct _timer      *next;	/* Run list */
    int                 (*func) (void *data);
    void               *data;
    char                again;
+   char                dead;	/* Deleted, remove when reaching top */
 };
 
 static int
@@ -40,37 +44,122 @@ tdiff(unsigned int t1, unsigned int t2)
    return (int)(t1 - t2);
 }
 
-static Timer       *q_first = NULL;
+/*
+ * Timer queue - binary min-heap ordered by at_time (then insertion order).
+ * TimerDel just marks the timer dead, dead timers are freed when they reach
+ * the top of the heap, or when the heap is compacted.
+ */
+static struct {
+   Timer             **heap;
+   int                 num;	/* Entries in heap (including dead) */
+   int                 size;	/* Allocated */
+   int                 dead;	/* Dead entries in heap */
+   unsigned int        seqn;
+} tq;
+
+/*
+ * Timers with slack may be delayed by up to slack ms, so expirations close
+ * to each other can be handled in one wakeup. When there has been no user
+ * input for a while (idle mode) the slack is widened.
+ */
+static unsigned int
+_TimerSlack(const Timer * timer)
+{
+   if (timer->slack && Conf.timers.idle_delay > 0 &&
+       tdiff(Mode.events.time_ms, Mode.events.input_time_ms) >
+       Conf.timers.idle_delay)
+      return timer->slack * Conf.timers.idle_slack_factor;
+
+   return timer->slack;
+}
+
+static int
+_TimerBefore(const Timer * t1, const Timer * t2)
+{
+   int                 dt;
+
+   dt = tdiff(t1->at_time, t2->at_time);
+   if (dt)
+      return dt < 0;
+   return tdiff(t1->seqn, t2->seqn) < 0;
+}
 
 static void
-_TimerSet(Timer * timer)
+_TimerHeapPut(int ix, Timer * timer)
+{
+   tq.heap[ix] = timer;
+   timer->hix = ix;
+}
+
+static void
+_TimerHeapUp(int ix)
+{
+   Timer              *timer = tq.heap[ix];
+   int                 pix;
+
+   for (; ix > 0; ix = pix)
+     {
+	pix = (ix - 1) / 2;
+	if (!_TimerBefore(timer, tq.heap[pix]))
+	   break;
+	_TimerHeapPut(ix, tq.heap[pix]);
+     }
+   _TimerHeapPut(ix, timer);
+}
+
+static void
+_TimerHeapDown(int ix)
 {
-   Timer              *ptr, *pptr;
+   Timer              *timer = tq.heap[ix];
+   int                 cix;
 
+   for (;; ix = cix)
+     {
+	cix = 2 * ix + 1;
+	if (cix >= tq.num)
+	   break;
+	if (cix + 1 < tq.num && _TimerBefore(tq.heap[cix + 1], tq.heap[cix]))
+	   cix++;
+	if (!_TimerBefore(tq.heap[cix], timer))
+	   break;
+	_TimerHeapPut(ix, tq.heap[cix]);
+     }
+   _TimerHeapPut(ix, timer);
+}
+
+static Timer       *
+_TimerHeapPop(void)
+{
+   Timer              *timer;
+
+   timer = tq.heap[0];
+   timer->hix = -1;
+   tq.num--;
+   if (tq.num > 0)
+     {
+	tq.heap[0] = tq.heap[tq.num];
+	_TimerHeapDown(0);
+     }
+
+   return timer;
+}
+
+static void
+_TimerSet(Timer * timer)
+{
    if (EDebug(EDBUG_TYPE_TIMERS) > 1)
       Eprintf("%s %p: func=%p data=%p\n", __func__, timer, timer->func,
 	      timer->data);
 
-   /* if there is no queue it becomes the queue */
-   if (!q_first)
+   if (tq.num >= tq.size)
      {
-	q_first = timer;
-	timer->next = NULL;
-     }
-   else
-     {
-	pptr = NULL;
-	for (ptr = q_first; ptr; pptr = ptr, ptr = ptr->next)
-	  {
-	     if (tdiff(ptr->at_time, timer->at_time) > 0)
-		break;
-	  }
-	if (pptr)
-	   pptr->next = timer;
-	else
-	   q_first = timer;
-	timer->next = ptr;
+	tq.size = (tq.size > 0) ? 2 * tq.size : 16;
+	tq.heap = EREALLOC(Timer *, tq.heap, tq.size);
      }
+
+   timer->seqn = tq.seqn++;
+   tq.heap[tq.num] = timer;
+   _TimerHeapUp(tq.num++);
 }
 
 static void
@@ -82,6 +171,49 @@ _TimerDel(Timer * timer)
    Efree(timer);
 }
 
+/* Free dead timers and rebuild the heap */
+static void
+_TimersCompact(void)
+{
+   Timer              *timer;
+   int                 i, n;
+
+   for (i = n = 0; i < tq.num; i++)
+     {
+	timer = tq.heap[i];
+	if (timer->dead)
+	   _TimerDel(timer);
+	else
+	   tq.heap[n++] = timer;
+     }
+   tq.num = n;
+   tq.dead = 0;
+
+   for (i = 0; i < n; i++)
+      tq.heap[i]->hix = i;
+   for (i = n / 2 - 1; i >= 0; i--)
+      _TimerHeapDown(i);
+}
+
+/* Get first live timer, freeing dead ones on top of the heap */
+static Timer       *
+_TimersFirst(void)
+{
+   Timer              *timer;
+
+   while (tq.num > 0)
+     {
+	timer = tq.heap[0];
+	if (!timer->dead)
+	   return timer;
+	_TimerHeapPop();
+	tq.dead--;
+	_TimerDel(timer);
+     }
+
+   return NULL;
+}
+
 Timer              *
 TimerAdd(int dt_ms, int (*func) (void *data), void *data)
 {
@@ -95,6 +227,8 @@ TimerAdd(int dt_ms, int (*func) (void *data), void *data)
    timer->at_time = GetTimeMs() + dt_ms;
    timer->func = func;
    timer->data = data;
+   timer->slack = 0;
+   timer->dead = 0;
 
    if (EDebug(EDBUG_TYPE_TIMERS))
       Eprintf("%s %p: func=%p data=%p: %8d\n", __func__, timer,
@@ -108,14 +242,11 @@ TimerAdd(int dt_ms, int (*func) (void *data), void *data)
 void
 TimersRun(unsigned int t_ms)
 {
-   Timer              *timer, *q_old, *q_run;
+   Timer              *timer, *q_run, *q_last;
+   int                 i;
 
-   timer = q_first;
-   if (!timer)
-      return;			/* No timers pending */
-
-   q_run = q_old = timer;
-   for (; timer; timer = q_first)
+   q_run = q_last = NULL;
+   for (; (timer = _TimersFirst());)
      {
 	if (tdiff(timer->at_time, t_ms) > 0)
 	   break;
@@ -124,50 +255,89 @@ TimersRun(unsigned int t_ms)
 	   Eprintf("%s - run %p: func=%p data=%p: %8d\n", __func__, timer,
 		   timer->func, timer->data, timer->at_time - t_ms);
 
-	q_first = timer->next;
+	_TimerHeapPop();
+
+	/* Append to expired timer list */
+	timer->next = NULL;
+	if (q_last)
+	   q_last->next = timer;
+	else
+	   q_run = timer;
+	q_last = timer;
 
 	/* Run this callback */
 	timer->again = timer->func(timer->data);
-	q_run = timer;
      }
 
-   if (q_old != q_first)
+   /* Re-schedule/remove timers that have run */
+   for (timer = q_run; timer; timer = q_run)
      {
-	/* At least one timer has run */
-	q_run->next = NULL;	/* Terminate expired timer list */
-
-	/* Re-schedule/remove timers that have run */
-	for (timer = q_old; timer; timer = q_old)
+	q_run = timer->next;
+	if (timer->again)
+	  {
+	     timer->at_time += timer->in_time;
+	     _TimerSet(timer);	/* Add to timer queue */
+	  }
+	else
 	  {
-	     q_old = timer->next;
-	     if (timer->again)
-	       {
-		  timer->at_time += timer->in_time;
-		  _TimerSet(timer);	/* Add to timer queue */
-	       }
-	     else
-	       {
-		  _TimerDel(timer);
-	       }
+	     _TimerDel(timer);
 	  }
      }
 
    if (EDebug(EDBUG_TYPE_TIMERS) > 1)
      {
-	for (timer = q_first; timer; timer = timer->next)
-	   Eprintf("%s - pend %p: func=%p data=%p: %8d (%d)\n", __func__,
-		   timer, timer->func, timer->data, timer->at_time - t_ms,
-		   timer->in_time);
+	for (i = 0; i < tq.num; i++)
+	  {
+	     timer = tq.heap[i];
+	     if (timer->dead)
+		continue;
+	     Eprintf("%s - pend %p: func=%p data=%p: %8d (%d)\n", __func__,
+		     timer, timer->func, timer->data, timer->at_time - t_ms,
+		     timer->in_time);
+	  }
+     }
+}
+
+/* Find earliest deadline (at_time + slack) in heap below ix.
+ * Subtrees expiring after the best deadline so far are skipped. */
+static void
+_TimersDeadline(int ix, unsigned int *pdl)
+{
+   Timer              *timer;
+   unsigned int        dl;
+
+   if (ix >= tq.num)
+      return;
+
+   timer = tq.heap[ix];
+   if (tdiff(timer->at_time, *pdl) >= 0)
+      return;
+
+   if (!timer->dead)
+     {
+	dl = timer->at_time + _TimerSlack(timer);
+	if (tdiff(dl, *pdl) < 0)
+	   *pdl = dl;
      }
+
+   _TimersDeadline(2 * ix + 1, pdl);
+   _TimersDeadline(2 * ix + 2, pdl);
 }
 
 int
 TimersRunNextIn(unsigned int t_ms)
 {
    Timer              *timer;
+   unsigned int        at_time;
    int                 dt;
 
-   timer = q_first;
+   timer = _TimersFirst();
+   if (timer)
+     {
+	at_time = timer->at_time + _TimerSlack(timer);
+	_TimersDeadline(1, &at_time);
+	_TimersDeadline(2, &at_time);
+     }
 
    /* If the next (rescheduled) timer is already expired, set timeout time
     * to 1 ms. This avoids starving the fd's and should maintain the intended
@@ -175,7 +345,7 @@ TimersRunNextIn(unsigned int t_ms)
     * The (mean) amount of work done in a timer function should of course not
     * exceed the timeout time. */
    if (timer)
-      dt = (int)(timer->at_time - t_ms) > 0 ? (int)(timer->at_time - t_ms) : 1;
+      dt = (int)(at_time - t_ms) > 0 ? (int)(at_time - t_ms) : 1;
    else
       dt = 0;
 
@@ -188,25 +358,15 @@ TimersRunNextIn(unsigned int t_ms)
 void
 TimerDel(Timer * timer)
 {
-   Timer              *qe, *ptr, *pptr;
+   /* Timers not in the queue (running) are handled by TimersRun() */
+   if (timer->hix < 0 || timer->dead)
+      return;
 
-   pptr = NULL;
-   for (ptr = q_first; ptr; pptr = ptr, ptr = ptr->next)
-     {
-	qe = ptr;
-	if (qe != timer)
-	   continue;
+   timer->dead = 1;
+   tq.dead++;
 
-	/* Match - remove it from the queue */
-	if (pptr)
-	   pptr->next = qe->next;
-	else
-	   q_first = qe->next;
-
-	/* free it */
-	_TimerDel(timer);
-	break;
-     }
+   if (tq.dead > 32 && tq.dead > tq.num / 2)
+      _TimersCompact();
 }
 
 void
@@ -215,6 +375,14 @@ TimerSetInterval(Timer * timer, int dt_ms)
    timer->in_time = (unsigned int)dt_ms;
 }
 
+void
+TimerSetSlack(Timer * timer, int slack_ms)
+{
+   if (!timer)
+      return;
+   timer->slack = (slack_ms > 0) ? (unsigned int)slack_ms : 0;
+}
+
 /*
  * Idlers
  */
@@ -29,6 +29,7 @@
 Timer              *TimerAdd(int dt_ms, int (*func) (void *data), void *data);
 void                TimerDel(Timer * timer);
 void                TimerSetInterval(Timer * timer, int dt_ms);
+void                TimerSetSlack(Timer * timer, int slack_ms);
 void                TimersRun(unsigned int t_ms);
 int                 TimersRunNextIn(unsigned int t_ms);
 
@@ -795,6 +795,7 @@ TooltipsSetPending(int type, CB_GetAclass * func, void *data)
       return;
 
    TIMER_ADD(tt_timer, Conf_tooltips.delay, ToolTipTimeout, NULL);
+   TimerSetSlack(tt_timer, 20);
 }
 
 /*
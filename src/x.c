@@ -23,6 +23,7 @@
  */
 #include "config.h"
 
+#include <limits.h>
 #include <string.h>
 #include <unistd.h>
 #include <X11/Xatom.h>
@@ -40,6 +41,7 @@
 
 #include "E.h"
 #include "edebug.h"
+#include "ipc.h"
 #include "util.h"
 #include "xwin.h"
 #if USE_GLX
@@ -57,25 +59,148 @@ static Visual      *argb_visual = NULL;
 static EX_Colormap  argb_cmap = NoXID;
 #endif
 
-static XContext     xid_context = 0;
+/*
+ * XID -> Win registry.
+ * Open addressing (linear probing, backward shift deletion) keyed by XID.
+ * Win structs are handed out from slabs and recycled through a free list.
+ */
+#define XID_HASH_MIN_BITS	8
+#define XID_SLAB_SIZE		128
+
+static struct {
+   Win                *tbl;
+   unsigned int        bits;	/* Table size is 1 << bits */
+   unsigned int        num;	/* Used slots */
+   Win                 free;	/* Free Win structs, linked via next */
+} xid_hash;
 
 static Win          win_first = NULL;
 static Win          win_last = NULL;
 
 #define WinBgInvalidate(win) if (win->bg_owned > 0) win->bg_owned = -1
 
+#define XID_HASH(xwin, bits) \
+   ((unsigned int)((unsigned int)(xwin) * 2654435761u) >> (32 - (bits)))
+
 void
 EXInit(void)
 {
    memset(&Dpy, 0, sizeof(Dpy));
 }
 
+static void
+_EXidHashResize(unsigned int bits)
+{
+   Win                *tbl, win;
+   unsigned int        i, j, size, mask;
+
+   size = 1U << bits;
+   mask = size - 1;
+   tbl = ECALLOC(Win, size);
+
+   for (i = 0; xid_hash.tbl && i < (1U << xid_hash.bits); i++)
+     {
+	win = xid_hash.tbl[i];
+	if (!win)
+	   continue;
+	for (j = XID_HASH(win->xwin, bits); tbl[j]; j = (j + 1) & mask)
+	   ;
+	tbl[j] = win;
+     }
+
+   Efree(xid_hash.tbl);
+   xid_hash.tbl = tbl;
+   xid_hash.bits = bits;
+}
+
+static void
+_EXidHashAdd(Win win)
+{
+   unsigned int        i, mask;
+
+   /* Keep load factor <= 1/2 */
+   if (!xid_hash.tbl)
+      _EXidHashResize(XID_HASH_MIN_BITS);
+   else if (2 * (xid_hash.num + 1) > (1U << xid_hash.bits))
+      _EXidHashResize(xid_hash.bits + 1);
+
+   mask = (1U << xid_hash.bits) - 1;
+   for (i = XID_HASH(win->xwin, xid_hash.bits);; i = (i + 1) & mask)
+     {
+	if (!xid_hash.tbl[i])
+	  {
+	     xid_hash.num++;
+	     break;
+	  }
+	if (xid_hash.tbl[i]->xwin == win->xwin)
+	   break;		/* Replace, like XSaveContext */
+     }
+   xid_hash.tbl[i] = win;
+}
+
+static void
+_EXidHashDel(Win win)
+{
+   unsigned int        i, j, k, mask;
+
+   if (!xid_hash.tbl)
+      return;
+
+   mask = (1U << xid_hash.bits) - 1;
+   for (i = XID_HASH(win->xwin, xid_hash.bits);; i = (i + 1) & mask)
+     {
+	if (!xid_hash.tbl[i])
+	   return;
+	if (xid_hash.tbl[i] == win)
+	   break;
+     }
+
+   /* Shift following entries of the cluster back into the hole */
+   for (j = i;;)
+     {
+	xid_hash.tbl[i] = NULL;
+	for (;;)
+	  {
+	     j = (j + 1) & mask;
+	     if (!xid_hash.tbl[j])
+		goto done;
+	     k = XID_HASH(xid_hash.tbl[j]->xwin, xid_hash.bits);
+	     /* Move unless k is cyclically in (i, j] */
+	     if (i <= j ? (i >= k || k > j) : (i >= k && k > j))
+		break;
+	  }
+	xid_hash.tbl[i] = xid_hash.tbl[j];
+	i = j;
+     }
+
+ done:
+   xid_hash.num--;
+   if (xid_hash.bits > XID_HASH_MIN_BITS &&
+       8 * xid_hash.num < (1U << xid_hash.bits))
+      _EXidHashResize(xid_hash.bits - 1);
+}
+
 static              Win
 _EXidCreate(void)
 {
    Win                 win;
+   int                 i;
 
-   win = ECALLOC(struct _xwin, 1);
+   if (!xid_hash.free)
+     {
+	/* Slabs are never returned, Wins are recycled */
+	win = EMALLOC(struct _xwin, XID_SLAB_SIZE);
+	if (!win)
+	   return NULL;
+	for (i = 0; i < XID_SLAB_SIZE - 1; i++)
+	   win[i].next = &win[i + 1];
+	win[i].next = NULL;
+	xid_hash.free = win;
+     }
+
+   win = xid_hash.free;
+   xid_hash.free = win->next;
+   memset(win, 0, sizeof(struct _xwin));
 
    win->bgcol = 0xffffffff;
 
@@ -91,7 +216,8 @@ _EXidDestroy(Win win)
    if (win->rects)
       XFree(win->rects);
    Efree(win->cbl.lst);
-   Efree(win);
+   win->next = xid_hash.free;
+   xid_hash.free = win;
 }
 
 static void
@@ -100,10 +226,7 @@ _EXidAdd(Win win)
 #if DEBUG_XWIN
    Eprintf("%s: %p %#x\n", __func__, win, win->xwin);
 #endif
-   if (!xid_context)
-      xid_context = XUniqueContext();
-
-   XSaveContext(disp, win->xwin, xid_context, (XPointer) win);
+   _EXidHashAdd(win);
 
    if (!win_first)
      {
@@ -146,7 +269,7 @@ _EXidDel(Win win)
 	win->next->prev = win->prev;
      }
 
-   XDeleteContext(disp, win->xwin, xid_context);
+   _EXidHashDel(win);
    if (win->in_use)
       win->do_del = 1;
    else
@@ -159,17 +282,91 @@ Win
 EXidLookup(EX_Window xwin)
 {
    Win                 win;
-   XPointer            xp;
+   unsigned int        i, mask;
 
-   if (!xid_context)
+   if (!xid_hash.tbl)
       return NULL;
 
-   xp = NULL;
-   if (XFindContext(disp, xwin, xid_context, &xp) == XCNOENT)
-      xp = NULL;
-   win = (Win) xp;
+   mask = (1U << xid_hash.bits) - 1;
+   for (i = XID_HASH(xwin, xid_hash.bits);; i = (i + 1) & mask)
+     {
+	win = xid_hash.tbl[i];
+	if (!win || win->xwin == xwin)
+	   return win;
+     }
+}
 
-   return win;
+#if ENABLE_BENCHMARKS
+/*
+ * Time insert/lookup/delete of num dummy windows, compared to the XContext
+ * based registry used previously.
+ * The dummy XIDs have bits set that are never set in real XIDs.
+ */
+void
+EXidBench(int num)
+{
+   Win                *wl, win;
+   XContext            xc;
+   XPointer            xp;
+   unsigned int        t0, t1, t2, t3, t4;
+   int                 i, nfound;
+
+   wl = EMALLOC(Win, num);
+   if (!wl)
+      return;
+
+   t0 = GetTimeUs();
+   for (i = 0; i < num; i++)
+     {
+	wl[i] = win = _EXidCreate();
+	win->xwin = 0xe0000000 | i;
+	_EXidAdd(win);
+     }
+   t1 = GetTimeUs();
+   for (i = nfound = 0; i < 4 * num; i++)
+      if (EXidLookup(0xe0000000 | (i % num)))
+	 nfound++;
+   t2 = GetTimeUs();
+   for (i = 0; i < num; i++)
+      if (EXidLookup(0xf0000000 | i))
+	 nfound++;
+   t3 = GetTimeUs();
+   for (i = 0; i < num; i++)
+      _EXidDel(wl[i]);
+   t4 = GetTimeUs();
+   IpcPrintf("Hash:     add %.3f  find %.3f  miss %.3f  del %.3f us/op (%d)\n",
+	     (double)(t1 - t0) / num, (double)(t2 - t1) / (4 * num),
+	     (double)(t3 - t2) / num, (double)(t4 - t3) / num, nfound);
+
+   xc = XUniqueContext();
+   t0 = GetTimeUs();
+   for (i = 0; i < num; i++)
+      XSaveContext(disp, 0xe0000000 | i, xc, (XPointer) wl);
+   t1 = GetTimeUs();
+   for (i = nfound = 0; i < 4 * num; i++)
+      if (XFindContext(disp, 0xe0000000 | (i % num), xc, &xp) == 0)
+	 nfound++;
+   t2 = GetTimeUs();
+   for (i = 0; i < num; i++)
+      if (XFindContext(disp, 0xf0000000 | i, xc, &xp) == 0)
+	 nfound++;
+   t3 = GetTimeUs();
+   for (i = 0; i < num; i++)
+      XDeleteContext(disp, 0xe0000000 | i, xc);
+   t4 = GetTimeUs();
+   IpcPrintf("XContext: add %.3f  find %.3f  miss %.3f  del %.3f us/op (%d)\n",
+	     (double)(t1 - t0) / num, (double)(t2 - t1) / (4 * num),
+	     (double)(t3 - t2) / num, (double)(t4 - t3) / num, nfound);
+
+   Efree(wl);
+}
+#endif /* ENABLE_BENCHMARKS */
+
+void
+EXidShow(void)
+{
+   IpcPrintf("Windows: %u  Table size: %u\n",
+	     xid_hash.num, xid_hash.tbl ? 1U << xid_hash.bits : 0);
 }
 
 static              Win
@@ -2336,6 +2533,7 @@ ERegionSubtract(EX_SrvRegion dst, EX_SrvRegion src)
    XFixesSubtractRegion(disp, dst, dst, src);
 }
 
+#if 0				/* Unused */
 void
 ERegionIntersectOffset(EX_SrvRegion dst, int dx, int dy, EX_SrvRegion src,
 		       EX_SrvRegion tmp)
@@ -2351,6 +2549,7 @@ ERegionIntersectOffset(EX_SrvRegion dst, int dx, int dy, EX_SrvRegion src,
      }
    XFixesIntersectRegion(dpy, dst, dst, rgn);
 }
+#endif
 
 void
 ERegionSubtractOffset(EX_SrvRegion dst, int dx, int dy, EX_SrvRegion src,
@@ -2432,4 +2631,625 @@ ERegionShow(const char *txt, EX_SrvRegion rgn,
       XFree(pr);
 }
 
+/* Return total area (pixels) and number of rectangles (debug) */
+unsigned int
+ERegionGetArea(EX_SrvRegion rgn, int *pnr)
+{
+   int                 i, nr;
+   XRectangle         *pr;
+   unsigned int        area;
+
+   area = nr = 0;
+   pr = (rgn != NoXID) ? XFixesFetchRegion(disp, rgn, &nr) : NULL;
+   if (!pr)
+      nr = 0;
+   for (i = 0; i < nr; i++)
+      area += pr[i].width * pr[i].height;
+   if (pr)
+      XFree(pr);
+
+   if (pnr)
+      *pnr = nr;
+   return area;
+}
+
+/*
+ * Client side regions
+ *
+ * Y-X banded rectangle lists, like the server (and Xlib) regions.
+ * Used where the region arithmetic is done per frame, so that only the
+ * final result needs to be sent to the server.
+ */
+
+typedef struct {
+   int                 x1, y1, x2, y2;
+} ECBox;
+
+struct _ECRegion {
+   int                 num, size;
+   ECBox              *boxes;	/* Sorted by y, then x, in bands */
+   ECBox               extents;
+};
+
+#define ECRGN_UNION      0
+#define ECRGN_INTERSECT  1
+#define ECRGN_SUBTRACT   2
+
+static struct _ECRegion ecrgn_tmp;	/* Operation result */
+static XRectangle  *ecrgn_xr;	/* Rectangle buffer for the server */
+static int          ecrgn_xr_size;
+
+static int
+_ECRegionGrow(EX_Region rgn, int num)
+{
+   ECBox              *b;
+   int                 size;
+
+   if (num <= rgn->size)
+      return 0;
+
+   size = (rgn->size > 0) ? 2 * rgn->size : 16;
+   while (size < num)
+      size *= 2;
+   b = EREALLOC(ECBox, rgn->boxes, size);
+   if (!b)
+      return -1;
+   rgn->boxes = b;
+   rgn->size = size;
+   return 0;
+}
+
+static void
+_ECRegionSetExtents(EX_Region rgn)
+{
+   const ECBox        *b;
+   int                 i;
+
+   if (rgn->num <= 0)
+     {
+	memset(&rgn->extents, 0, sizeof(rgn->extents));
+	return;
+     }
+
+   rgn->extents = rgn->boxes[0];
+   rgn->extents.y2 = rgn->boxes[rgn->num - 1].y2;
+   for (i = 1, b = rgn->boxes + 1; i < rgn->num; i++, b++)
+     {
+	if (rgn->extents.x1 > b->x1)
+	   rgn->extents.x1 = b->x1;
+	if (rgn->extents.x2 < b->x2)
+	   rgn->extents.x2 = b->x2;
+     }
+}
+
+/* Get rectangles in the buffer shared by the server request helpers */
+static XRectangle  *
+_ECRegionGetXRects(EX_Region rgn, int *pnr)
+{
+   XRectangle         *pr;
+   const ECBox        *b;
+   int                 i;
+
+   if (rgn->num > ecrgn_xr_size)
+     {
+	pr = EREALLOC(XRectangle, ecrgn_xr, rgn->num);
+	if (!pr)
+	  {
+	     *pnr = 0;
+	     return ecrgn_xr;
+	  }
+	ecrgn_xr = pr;
+	ecrgn_xr_size = rgn->num;
+     }
+
+   for (i = 0, b = rgn->boxes, pr = ecrgn_xr; i < rgn->num; i++, b++, pr++)
+     {
+	pr->x = b->x1;
+	pr->y = b->y1;
+	pr->width = b->x2 - b->x1;
+	pr->height = b->y2 - b->y1;
+     }
+   *pnr = rgn->num;
+   return ecrgn_xr;
+}
+
+/* Number of boxes in band starting at i */
+static int
+_ECRegionBandLen(EX_Region rgn, int i)
+{
+   int                 n;
+
+   for (n = 1; i + n < rgn->num; n++)
+      if (rgn->boxes[i + n].y1 != rgn->boxes[i].y1)
+	 break;
+   return n;
+}
+
+/* Combine the x-intervals of two bands (a, na) and (b, nb) into the band
+ * y1-y2 of the result */
+static int
+_ECRegionBandOp(EX_Region res, int op, int y1, int y2,
+		const ECBox * a, int na, const ECBox * b, int nb)
+{
+   int                 x1, x2, nb0;
+   ECBox              *r;
+
+   /* Worst case number of output boxes */
+   if (_ECRegionGrow(res, res->num + na + nb + 1))
+      return -1;
+
+#define EMIT(_x1, _x2) \
+   do { r = res->boxes + res->num++; \
+	r->x1 = _x1; r->y1 = y1; r->x2 = _x2; r->y2 = y2; } while (0)
+
+   switch (op)
+     {
+     case ECRGN_UNION:
+	for (x1 = x2 = 0; na > 0 || nb > 0;)
+	  {
+	     const ECBox        *p;
+
+	     if (nb <= 0 || (na > 0 && a->x1 < b->x1))
+		p = a++, na--;
+	     else
+		p = b++, nb--;
+	     if (x2 > x1 && p->x1 <= x2)
+	       {
+		  if (x2 < p->x2)
+		     x2 = p->x2;
+		  continue;
+	       }
+	     if (x2 > x1)
+		EMIT(x1, x2);
+	     x1 = p->x1;
+	     x2 = p->x2;
+	  }
+	if (x2 > x1)
+	   EMIT(x1, x2);
+	break;
+
+     case ECRGN_INTERSECT:
+	while (na > 0 && nb > 0)
+	  {
+	     x1 = MAX(a->x1, b->x1);
+	     x2 = MIN(a->x2, b->x2);
+	     if (x1 < x2)
+		EMIT(x1, x2);
+	     if (a->x2 < b->x2)
+		a++, na--;
+	     else
+		b++, nb--;
+	  }
+	break;
+
+     case ECRGN_SUBTRACT:
+	for (; na > 0; a++, na--)
+	  {
+	     x1 = a->x1;
+	     /* Skip b's entirely left of a */
+	     while (nb > 0 && b->x2 <= x1)
+		b++, nb--;
+	     for (nb0 = 0; nb0 < nb && b[nb0].x1 < a->x2; nb0++)
+	       {
+		  if (b[nb0].x1 > x1)
+		     EMIT(x1, b[nb0].x1);
+		  if (b[nb0].x2 > x1)
+		     x1 = b[nb0].x2;
+	       }
+	     if (x1 < a->x2)
+		EMIT(x1, a->x2);
+	  }
+	break;
+     }
+#undef EMIT
+
+   return 0;
+}
+
+/* Merge band starting at i with the previous one (starting at ip) if they
+ * are adjacent and have the same x-intervals */
+static int
+_ECRegionCoalesce(EX_Region rgn, int ip, int i)
+{
+   ECBox              *p, *b;
+   int                 n;
+
+   n = rgn->num - i;
+   if (ip < 0 || i - ip != n || n == 0)
+      return i;
+   p = rgn->boxes + ip;
+   b = rgn->boxes + i;
+   if (p->y2 != b->y1)
+      return i;
+   for (; n > 0; n--, p++, b++)
+      if (p->x1 != b->x1 || p->x2 != b->x2)
+	 return i;
+
+   for (n = ip; n < i; n++)
+      rgn->boxes[n].y2 = rgn->boxes[i].y2;
+   rgn->num = i;
+   return ip;
+}
+
+static void
+_ECRegionOp(EX_Region dst, EX_Region ra, EX_Region rb, int op)
+{
+   EX_Region           res = &ecrgn_tmp;
+   ECBox              *tmp;
+   int                 ia, ib, na, nb, ya, yb, y1, y2, ip, i, size;
+
+   res->num = 0;
+   ip = -1;
+   ia = ib = 0;
+   na = (ra->num > 0) ? _ECRegionBandLen(ra, 0) : 0;
+   nb = (rb->num > 0) ? _ECRegionBandLen(rb, 0) : 0;
+   y1 = MIN(na ? ra->boxes[0].y1 : INT_MAX, nb ? rb->boxes[0].y1 : INT_MAX);
+
+   while (ia < ra->num || ib < rb->num)
+     {
+	/* The a/b bands from y1 are active, or start at ya/yb */
+	ya = (ia < ra->num) ? ra->boxes[ia].y1 : INT_MAX;
+	yb = (ib < rb->num) ? rb->boxes[ib].y1 : INT_MAX;
+	if (y1 < MIN(ya, yb) && ya > y1 && yb > y1)
+	   y1 = MIN(ya, yb);
+
+	y2 = INT_MAX;
+	if (ya <= y1)
+	   y2 = MIN(y2, ra->boxes[ia].y2);
+	else
+	   y2 = MIN(y2, ya);
+	if (yb <= y1)
+	   y2 = MIN(y2, rb->boxes[ib].y2);
+	else
+	   y2 = MIN(y2, yb);
+
+	i = res->num;
+	if (_ECRegionBandOp(res, op, y1, y2,
+			    ra->boxes + ia, (ya <= y1) ? na : 0,
+			    rb->boxes + ib, (yb <= y1) ? nb : 0))
+	  {
+	     res->num = 0;
+	     break;
+	  }
+	ip = _ECRegionCoalesce(res, ip, i);
+	if (res->num == i)
+	   ip = (i > 0) ? ip : -1;
+
+	y1 = y2;
+	if (ia < ra->num && ra->boxes[ia].y2 <= y1)
+	  {
+	     ia += na;
+	     na = (ia < ra->num) ? _ECRegionBandLen(ra, ia) : 0;
+	  }
+	if (ib < rb->num && rb->boxes[ib].y2 <= y1)
+	  {
+	     ib += nb;
+	     nb = (ib < rb->num) ? _ECRegionBandLen(rb, ib) : 0;
+	  }
+
+	/* Nothing more can come out of these */
+	if (op != ECRGN_UNION && ia >= ra->num)
+	   break;
+	if (op == ECRGN_INTERSECT && ib >= rb->num)
+	   break;
+     }
+
+   /* Swap result into dst */
+   tmp = dst->boxes;
+   size = dst->size;
+   dst->boxes = res->boxes;
+   dst->size = res->size;
+   dst->num = res->num;
+   res->boxes = tmp;
+   res->size = size;
+   res->num = 0;
+
+   _ECRegionSetExtents(dst);
+}
+
+EX_Region
+ECRegionCreate(void)
+{
+   return ECALLOC(struct _ECRegion, 1);
+}
+
+void
+ECRegionDestroy(EX_Region rgn)
+{
+   if (!rgn)
+      return;
+   Efree(rgn->boxes);
+   Efree(rgn);
+}
+
+void
+ECRegionEmpty(EX_Region rgn)
+{
+   rgn->num = 0;
+   memset(&rgn->extents, 0, sizeof(rgn->extents));
+}
+
+int
+ECRegionIsEmpty(EX_Region rgn)
+{
+   return rgn->num <= 0;
+}
+
+void
+ECRegionSetRect(EX_Region rgn, int x, int y, int w, int h)
+{
+   ECRegionEmpty(rgn);
+   if (w <= 0 || h <= 0 || _ECRegionGrow(rgn, 1))
+      return;
+   rgn->boxes[0].x1 = x;
+   rgn->boxes[0].y1 = y;
+   rgn->boxes[0].x2 = x + w;
+   rgn->boxes[0].y2 = y + h;
+   rgn->num = 1;
+   rgn->extents = rgn->boxes[0];
+}
+
+/* Set region from y-x banded rectangles (as they come from the server) */
+static void
+_ECRegionSetBanded(EX_Region rgn, const XRectangle * pr, int nr)
+{
+   ECBox              *b;
+   int                 i;
+
+   ECRegionEmpty(rgn);
+   if (_ECRegionGrow(rgn, nr))
+      return;
+
+   for (i = 0, b = rgn->boxes; i < nr; i++, pr++)
+     {
+	if (pr->width == 0 || pr->height == 0)
+	   continue;
+	b->x1 = pr->x;
+	b->y1 = pr->y;
+	b->x2 = pr->x + pr->width;
+	b->y2 = pr->y + pr->height;
+	b++;
+     }
+   rgn->num = b - rgn->boxes;
+   _ECRegionSetExtents(rgn);
+}
+
+void
+ECRegionSetRects(EX_Region rgn, const XRectangle * pr, int nr, int banded)
+{
+   struct _ECRegion    r;
+   ECBox               b;
+   int                 i;
+
+   if (banded)
+     {
+	_ECRegionSetBanded(rgn, pr, nr);
+	return;
+     }
+
+   ECRegionEmpty(rgn);
+   r.num = r.size = 1;
+   r.boxes = &b;
+   for (i = 0; i < nr; i++, pr++)
+     {
+	if (pr->width == 0 || pr->height == 0)
+	   continue;
+	b.x1 = pr->x;
+	b.y1 = pr->y;
+	b.x2 = pr->x + pr->width;
+	b.y2 = pr->y + pr->height;
+	r.extents = b;
+	_ECRegionOp(rgn, rgn, &r, ECRGN_UNION);
+     }
+}
+
+/* Window bounding region (relative to window origin, like
+ * XFixesCreateRegionFromWindow(..., WindowRegionBounding)) */
+void
+ECRegionSetFromShape(EX_Region rgn, Win win)
+{
+   int                 bw;
+
+   if (win->num_rect < 0)
+     {
+	ECRegionEmpty(rgn);
+     }
+   else if (win->num_rect == 0)
+     {
+	bw = win->bw;
+	ECRegionSetRect(rgn, -bw, -bw, win->w + 2 * bw, win->h + 2 * bw);
+     }
+   else
+     {
+	ECRegionSetRects(rgn, win->rects, win->num_rect, win->ord == YXBanded);
+     }
+}
+
+EX_Region
+ECRegionCopy(EX_Region dst, EX_Region src)
+{
+   if (dst == src)
+      return dst;
+   ECRegionEmpty(dst);
+   if (_ECRegionGrow(dst, src->num))
+      return dst;
+   memcpy(dst->boxes, src->boxes, src->num * sizeof(ECBox));
+   dst->num = src->num;
+   dst->extents = src->extents;
+   return dst;
+}
+
+void
+ECRegionTranslate(EX_Region rgn, int dx, int dy)
+{
+   ECBox              *b;
+   int                 i;
+
+   if (dx == 0 && dy == 0)
+      return;
+   for (i = 0, b = rgn->boxes; i < rgn->num; i++, b++)
+     {
+	b->x1 += dx;
+	b->y1 += dy;
+	b->x2 += dx;
+	b->y2 += dy;
+     }
+   _ECRegionSetExtents(rgn);
+}
+
+#define EXTENTS_DISJOINT(r1, r2) \
+   ((r1)->x2 <= (r2)->x1 || (r1)->x1 >= (r2)->x2 || \
+    (r1)->y2 <= (r2)->y1 || (r1)->y1 >= (r2)->y2)
+
+void
+ECRegionIntersect(EX_Region dst, EX_Region src)
+{
+   if (dst->num <= 0)
+      return;
+   if (src->num <= 0 || EXTENTS_DISJOINT(&dst->extents, &src->extents))
+     {
+	ECRegionEmpty(dst);
+	return;
+     }
+   _ECRegionOp(dst, dst, src, ECRGN_INTERSECT);
+}
+
+void
+ECRegionSubtract(EX_Region dst, EX_Region src)
+{
+   if (dst->num <= 0 || src->num <= 0 ||
+       EXTENTS_DISJOINT(&dst->extents, &src->extents))
+      return;
+   _ECRegionOp(dst, dst, src, ECRGN_SUBTRACT);
+}
+
+void
+ECRegionUnion(EX_Region dst, EX_Region src)
+{
+   if (src->num <= 0 || dst == src)
+      return;
+   if (dst->num <= 0)
+     {
+	ECRegionCopy(dst, src);
+	return;
+     }
+   _ECRegionOp(dst, dst, src, ECRGN_UNION);
+}
+
+/* Get client side copy of server region (round trip) */
+void
+ECRegionFetch(EX_Region dst, EX_SrvRegion src)
+{
+   XRectangle         *pr;
+   int                 nr;
+
+   pr = (src != NoXID) ? XFixesFetchRegion(disp, src, &nr) : NULL;
+   if (!pr)
+     {
+	ECRegionEmpty(dst);
+	return;
+     }
+   _ECRegionSetBanded(dst, pr, nr);
+   XFree(pr);
+}
+
+/* Get rectangles (XRectangle's) of region. Must be freed by caller. */
+XRectangle         *
+ECRegionGetRects(EX_Region rgn, int *pnr)
+{
+   XRectangle         *pr, *pr2;
+   int                 nr;
+
+   pr2 = _ECRegionGetXRects(rgn, &nr);
+   pr = EMALLOC(XRectangle, nr > 0 ? nr : 1);
+   if (!pr)
+      nr = 0;
+   else if (nr > 0)
+      memcpy(pr, pr2, nr * sizeof(XRectangle));
+   *pnr = nr;
+   return pr;
+}
+
+unsigned int
+ECRegionGetArea(EX_Region rgn, int *pnr)
+{
+   const ECBox        *b;
+   unsigned int        area;
+   int                 i;
+
+   area = 0;
+   for (i = 0, b = rgn->boxes; i < rgn->num; i++, b++)
+      area += (b->x2 - b->x1) * (b->y2 - b->y1);
+
+   if (pnr)
+      *pnr = rgn->num;
+   return area;
+}
+
+void
+ECRegionGetBox(EX_Region rgn, XRectangle * box)
+{
+   box->x = rgn->extents.x1;
+   box->y = rgn->extents.y1;
+   box->width = rgn->extents.x2 - rgn->extents.x1;
+   box->height = rgn->extents.y2 - rgn->extents.y1;
+}
+
+/* Set server region from client side region */
+void
+ECRegionUpload(EX_SrvRegion dst, EX_Region src)
+{
+   XRectangle         *pr;
+   int                 nr;
+
+   pr = _ECRegionGetXRects(src, &nr);
+   XFixesSetRegion(disp, dst, pr, nr);
+}
+
+void
+ECRegionShow(const char *txt, EX_Region rgn,
+	     void (*prf) (const char *fmt, ...))
+{
+   int                 i;
+   const ECBox        *b;
+
+   prf = (prf) ? prf : Eprintf;
+
+   if (!rgn)
+     {
+	prf(" - cregion: %s is None\n", txt);
+	return;
+     }
+   if (rgn->num <= 0)
+     {
+	prf(" - cregion: %s is empty\n", txt);
+	return;
+     }
+
+   prf(" - cregion: %s:\n", txt);
+   for (i = 0, b = rgn->boxes; i < rgn->num; i++, b++)
+      prf("%4d: %4d+%4d %4dx%4d\n", i, b->x1, b->y1, b->x2 - b->x1,
+	  b->y2 - b->y1);
+}
+
+void
+EPictureSetClipRegion(EX_Picture pict, EX_Region clip)
+{
+   XRectangle         *pr;
+   int                 nr;
+
+   pr = _ECRegionGetXRects(clip, &nr);
+   XRenderSetPictureClipRectangles(disp, pict, 0, 0, pr, nr);
+}
+
+void
+EGCSetClipRegion(GC gc, EX_Region clip)
+{
+   XRectangle         *pr;
+   int                 nr;
+
+   pr = _ECRegionGetXRects(clip, &nr);
+   XSetClipRectangles(disp, gc, 0, 0, pr, nr, YXBanded);
+}
+
 #endif /* USE_COMPOSITE */
@@ -40,6 +40,7 @@
 #define EX_Time         unsigned int
 
 typedef struct _xwin *Win;
+typedef struct _ECRegion *EX_Region;	/* Client side region */
 
 #define NoXID   0U
 
@@ -119,6 +119,10 @@ struct _xwin {
 };
 
 Win                 ELookupXwin(EX_Window xwin);
+void                EXidShow(void);
+#if ENABLE_BENCHMARKS
+void                EXidBench(int num);
+#endif
 
 #define             WinGetXwin(win)		((win)->xwin)
 #define             WinGetPmap(win)		((win)->bgpmap)
@@ -350,8 +354,32 @@ int                 ERegionIsEmpty(EX_SrvRegion rgn);
 #endif
 void                ERegionShow(const char *txt, EX_SrvRegion rgn,
 				void (*prf) (const char *fmt, ...));
+unsigned int        ERegionGetArea(EX_SrvRegion rgn, int *pnr);
+
+EX_Region           ECRegionCreate(void);
+void                ECRegionDestroy(EX_Region rgn);
+void                ECRegionEmpty(EX_Region rgn);
+int                 ECRegionIsEmpty(EX_Region rgn);
+void                ECRegionSetRect(EX_Region rgn, int x, int y, int w, int h);
+void                ECRegionSetRects(EX_Region rgn, const XRectangle * pr,
+				     int nr, int banded);
+void                ECRegionSetFromShape(EX_Region rgn, Win win);
+EX_Region           ECRegionCopy(EX_Region dst, EX_Region src);
+void                ECRegionTranslate(EX_Region rgn, int dx, int dy);
+void                ECRegionIntersect(EX_Region dst, EX_Region src);
+void                ECRegionSubtract(EX_Region dst, EX_Region src);
+void                ECRegionUnion(EX_Region dst, EX_Region src);
+void                ECRegionFetch(EX_Region dst, EX_SrvRegion src);
+XRectangle         *ECRegionGetRects(EX_Region rgn, int *pnr);
+unsigned int        ECRegionGetArea(EX_Region rgn, int *pnr);
+void                ECRegionGetBox(EX_Region rgn, XRectangle * box);
+void                ECRegionUpload(EX_SrvRegion dst, EX_Region src);
+void                ECRegionShow(const char *txt, EX_Region rgn,
+				 void (*prf) (const char *fmt, ...));
 
 void                EPictureSetClip(EX_Picture pict, EX_SrvRegion clip);
+void                EPictureSetClipRegion(EX_Picture pict, EX_Region clip);
+void                EGCSetClipRegion(GC gc, EX_Region clip);
 
 EX_Pixmap           EWindowGetPixmap(const Win win);
 